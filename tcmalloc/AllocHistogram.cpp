@@ -0,0 +1,41 @@
+#include"AllocHistogram.h"
+#include<cstdio>
+#include<cstdlib>
+
+// 下标就是申请的字节数，只在被记录到的大小对应的页上产生物理内存
+static std::atomic<size_t> allocHistogram[MAX_BYTES + 1];
+
+void RecordAllocSize(size_t size, size_t count)
+{
+    if (size <= MAX_BYTES)
+        allocHistogram[size].fetch_add(count, std::memory_order_relaxed);
+}
+
+bool DumpAllocHistogram(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (fp == nullptr)
+        return false;
+
+    for (size_t size = 1; size <= MAX_BYTES; ++size)
+    {
+        size_t count = allocHistogram[size].load(std::memory_order_relaxed);
+        if (count != 0)
+            fprintf(fp, "%zu %zu\n", size, count);
+    }
+    return fclose(fp) == 0;
+}
+
+#ifdef ALLOC_HISTOGRAM
+// 进程退出时按环境变量写出直方图
+struct AllocHistogramDumper
+{
+    ~AllocHistogramDumper()
+    {
+        const char* path = getenv("TCMALLOC_HISTOGRAM_FILE");
+        if (path != nullptr && !DumpAllocHistogram(path))
+            fprintf(stderr, "alloc histogram: cannot write %s\n", path);
+    }
+};
+static AllocHistogramDumper allocHistogramDumper;
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#include"Common.h"
+
+// 按申请大小统计的直方图，用于离线生成贴合实际负载的尺寸类别表(见 SizeClassTool)
+// 编译时定义 ALLOC_HISTOGRAM 才会在 ConcurrentAlloc 里记录；
+// 设置环境变量 TCMALLOC_HISTOGRAM_FILE 则进程退出时自动写出
+void RecordAllocSize(size_t size, size_t count = 1);
+
+// 写出直方图，每行 "大小 次数"，只写次数非0的大小；超过 MAX_BYTES 的申请不记录
+bool DumpAllocHistogram(const char* path);
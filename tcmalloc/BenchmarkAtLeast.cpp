@@ -0,0 +1,88 @@
+#include"ConcurrentAlloc.h"
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<chrono>
+#include<vector>
+
+// 可用大小基准：模拟 push_back 逐个追加元素的数组，容量不够时按 1.5 倍扩容(新申请+复制+释放)。
+//  - 按申请大小定容量：类别取整多出来的部分被浪费，下一次扩容来得更早
+//  - 按 ConcurrentAllocAtLeast 返回的大小定容量：用满整个类别/整页，扩容次数更少
+struct GrowResult
+{
+	double _ms;
+	size_t _grows;
+};
+
+static GrowResult PushBack(size_t arrays, size_t elems, bool atLeast)
+{
+	GrowResult res{ 0, 0 };
+	std::vector<int*> data(arrays, nullptr);
+	std::vector<size_t> sizes(arrays, 0), caps(arrays, 0);
+
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t n = 0; n < elems; ++n)
+	{
+		// 多个数组交替追加，不让同一个数组一直占着缓存
+		for (size_t i = 0; i < arrays; ++i)
+		{
+			if (sizes[i] == caps[i])
+			{
+				size_t want = caps[i] < 4 ? 4 : caps[i] + caps[i] / 2;
+				int* p;
+				if (atLeast)
+				{
+					SizedPtr r = ConcurrentAllocAtLeast(want * sizeof(int));
+					p = (int*)r._ptr;
+					want = r._size / sizeof(int);
+				}
+				else
+				{
+					p = (int*)ConcurrentAlloc(want * sizeof(int));
+				}
+				if (data[i] != nullptr)
+				{
+					memcpy(p, data[i], sizes[i] * sizeof(int));
+					ConcurrentFree(data[i]);
+				}
+				data[i] = p;
+				caps[i] = want;
+				++res._grows;
+			}
+			data[i][sizes[i]++] = (int)n;
+		}
+	}
+	res._ms = (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+
+	for (int* p : data)
+		ConcurrentFree(p);
+	return res;
+}
+
+void BenchmarkAtLeast(size_t arrays, size_t elems, size_t rounds)
+{
+	GrowResult plain{ 0, 0 }, sized{ 0, 0 };
+	for (size_t r = 0; r < rounds; ++r)
+	{
+		GrowResult a = PushBack(arrays, elems, false);
+		GrowResult b = PushBack(arrays, elems, true);
+		plain._ms += a._ms;
+		plain._grows += a._grows;
+		sized._ms += b._ms;
+		sized._grows += b._grows;
+	}
+	printf("%5zu个数组 x %8zu个int x %2zu轮: 按申请大小 %8.2f ms (扩容%zu次) | 按可用大小 %8.2f ms (扩容%zu次)\n",
+		arrays, elems, rounds, plain._ms, plain._grows, sized._ms, sized._grows);
+}
+
+int main()
+{
+	cout << "==========================================================" << endl;
+	BenchmarkAtLeast(10000, 20, 20);
+	BenchmarkAtLeast(1000, 1000, 10);
+	BenchmarkAtLeast(16, 1000000, 5);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include"ConcurrentAlloc.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+
+// 批量接口基准：一次建好大量同样大小的节点(比如一棵树)，再一次全部释放，
+// 对比逐个 ConcurrentAlloc/ConcurrentFree 与 ConcurrentAllocBatch/ConcurrentFreeBatch。
+// 每种方式先跑一轮预热，让页都已经向系统要过，计时只看分配器本身的开销。
+static double ElapsedNs(std::chrono::steady_clock::time_point begin)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - begin).count();
+}
+
+void BenchmarkBatch(size_t size, size_t n, size_t rounds)
+{
+	std::vector<void*> v(n);
+	double singleAlloc = 0, singleFree = 0, batchAlloc = 0, batchFree = 0;
+
+	for (size_t r = 0; r <= rounds; ++r)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < n; ++i)
+			v[i] = ConcurrentAlloc(size);
+		double a = ElapsedNs(begin);
+
+		begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < n; ++i)
+			ConcurrentFree(v[i]);
+		double f = ElapsedNs(begin);
+
+		if (r > 0)
+		{
+			singleAlloc += a;
+			singleFree += f;
+		}
+	}
+
+	for (size_t r = 0; r <= rounds; ++r)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		ConcurrentAllocBatch(size, n, v.data());
+		double a = ElapsedNs(begin);
+
+		begin = std::chrono::steady_clock::now();
+		ConcurrentFreeBatch(v.data(), n);
+		double f = ElapsedNs(begin);
+
+		if (r > 0)
+		{
+			batchAlloc += a;
+			batchFree += f;
+		}
+	}
+
+	double total = (double)n * rounds;
+	printf("%6zu字节 x %zu: 逐个 申请 %.2f ns/个 释放 %.2f ns/个 | 批量 申请 %.2f ns/个 释放 %.2f ns/个\n",
+		size, n, singleAlloc / total, singleFree / total, batchAlloc / total, batchFree / total);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t n = 1000000;
+	if (argc > 1)
+		n = strtoul(argv[1], nullptr, 10);
+
+	cout << "==========================================================" << endl;
+	// 大批量：远超线程缓存容量，大部分对象在中心缓存里切分/挂回
+	BenchmarkBatch(32, n, 5);
+	BenchmarkBatch(64, n, 5);
+	BenchmarkBatch(256, n, 5);
+	// 小批量：对象都在线程缓存里来回，只剩逐个调用本身的开销
+	BenchmarkBatch(32, 256, 20000);
+	BenchmarkBatch(256, 256, 20000);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<thread>
+
+// 线程池频繁换血的场景：依次创建并join大量短命线程，
+// 每个线程申请释放一批不同大小的对象，释放的对象留在它的ThreadCache里。
+// 线程退出时若不把缓存还给中心缓存，这些对象就永远滞留，RSS随线程数无限增长。
+void BenchmarkThreadChurn(size_t nthreads, size_t nworks, size_t batch)
+{
+	size_t rss_begin = GetRSS();
+	auto begin = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> vthread(nworks);
+	size_t report = nthreads / 10 ? nthreads / 10 : 1;
+	for (size_t created = 0; created < nthreads;)
+	{
+		size_t wave = std::min(nworks, nthreads - created);
+		for (size_t k = 0; k < wave; ++k)
+		{
+			vthread[k] = std::thread([batch, k]() {
+				void* v[128];
+				for (size_t i = 0; i < batch; i++)
+				{
+					v[i] = ConcurrentAlloc(((i + k) * 24) % 2048 + 8);
+				}
+				for (size_t i = 0; i < batch; i++)
+				{
+					ConcurrentFree(v[i]);
+				}
+			});
+		}
+		for (size_t k = 0; k < wave; ++k)
+		{
+			vthread[k].join();
+		}
+
+		size_t before = created;
+		created += wave;
+		if (created / report != before / report || created == nthreads)
+		{
+			printf("已创建并退出 %7zu 个线程, RSS %8.1f MB\n",
+				created, (double)GetRSS() / (1024 * 1024));
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	printf("%zu个短命线程(每批%zu个并发)，共耗时 %zu ms，RSS增长 %.1f MB\n",
+		nthreads, nworks,
+		(size_t)std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count(),
+		(double)(GetRSS() - rss_begin) / (1024 * 1024));
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nthreads = 100000;
+	if (argc > 1)
+		nthreads = strtoul(argv[1], nullptr, 10);
+
+	cout << "==========================================================" << endl;
+	BenchmarkThreadChurn(nthreads, 8, 128);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
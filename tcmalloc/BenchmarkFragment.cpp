@@ -0,0 +1,80 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<vector>
+#include<random>
+
+// 内碎片/RSS 基准：模拟服务里几个落在类别边界之间的热点大小(136、1040字节)，
+// 持有大量存活对象，对比默认类别表与当前编译所用类别表的内碎片和RSS。
+//
+// 定制类别表的完整流程：
+//   make clean && make ALLOC_HISTOGRAM=1
+//   TCMALLOC_HISTOGRAM_FILE=hist.txt ./bench_fragment
+//   ./size_class_tool hist.txt > SizeClassCustom.h
+//   make clean && make SIZE_CLASS_FILE=SizeClassCustom.h && ./bench_fragment
+
+// 默认类别表下的向上取整大小
+static size_t DefaultRoundUp(size_t size)
+{
+	static const SizeClassList list = GenerateDefaultSizeClasses();
+	for (size_t i = 0; i < list._count; ++i)
+	{
+		if (list._classes[i]._size >= size)
+			return list._classes[i]._size;
+	}
+	return size;
+}
+
+static size_t NextSize(std::mt19937& rng)
+{
+	size_t r = rng() % 100;
+	if (r < 45)
+		return 136;
+	if (r < 90)
+		return 1040;
+	return rng() % 4096 + 1;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t n = 300000;
+	if (argc > 1)
+		n = strtoul(argv[1], nullptr, 10);
+
+	std::mt19937 rng(12345);
+	std::vector<size_t> sizes(n);
+	for (size_t i = 0; i < n; ++i)
+		sizes[i] = NextSize(rng);
+
+	std::vector<void*> v(n);
+	size_t rssBefore = GetRSS();
+	size_t requested = 0, defaultBytes = 0, currentBytes = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		v[i] = ConcurrentAlloc(sizes[i]);
+		requested += sizes[i];
+		defaultBytes += DefaultRoundUp(sizes[i]);
+		currentBytes += SizeClass::RoundUp(sizes[i]);
+	}
+	size_t rssAfter = GetRSS();
+
+	cout << "==========================================================" << endl;
+#ifdef SIZE_CLASS_FILE
+	printf("类别表: %s (%zu 个类别)\n", SIZE_CLASS_FILE, NFREELIST);
+#else
+	printf("类别表: 默认 (%zu 个类别)\n", NFREELIST);
+#endif
+	printf("存活对象 %zu 个, 申请 %.2f MB\n", n, requested / 1048576.0);
+	printf("默认类别表: 取整后 %.2f MB, 内碎片 %.2f%%\n",
+		defaultBytes / 1048576.0, 100.0 * (defaultBytes - requested) / requested);
+	printf("当前类别表: 取整后 %.2f MB, 内碎片 %.2f%%\n",
+		currentBytes / 1048576.0, 100.0 * (currentBytes - requested) / requested);
+	printf("RSS 增长 %.2f MB\n", (rssAfter - rssBefore) / 1048576.0);
+	cout << "==========================================================" << endl;
+
+	for (size_t i = 0; i < n; ++i)
+		ConcurrentFree(v[i]);
+
+	return 0;
+}
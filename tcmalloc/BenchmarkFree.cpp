@@ -0,0 +1,94 @@
+#include"ConcurrentAlloc.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<thread>
+#include<atomic>
+
+// 释放密集型基准：每个线程先申请 ntimes 个对象（不计时），
+// 所有线程就绪后同时开始释放，统计整体释放吞吐量。
+// 释放路径若在全局锁上串行化，吞吐会在 2~4 线程后趋于平缓；
+// 无锁查找时吞吐应随线程数（核数）增长。
+template<class AllocFn, class FreeFn>
+double BenchmarkFreeThroughput(size_t ntimes, size_t nworks, size_t rounds, AllocFn alloc, FreeFn dealloc)
+{
+	std::vector<std::thread> vthread(nworks);
+	std::atomic<size_t> ready(0);
+	std::atomic<bool> go(false);
+	std::atomic<size_t> free_costtime(0); // 所有线程释放耗时之和(us)
+
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		vthread[k] = std::thread([&, k]() {
+			std::vector<void*> v(ntimes);
+
+			for (size_t j = 0; j < rounds; ++j)
+			{
+				for (size_t i = 0; i < ntimes; i++)
+				{
+					v[i] = alloc((16 + i * 7 + k) % 1024 + 1);
+				}
+
+				// 每轮所有线程对齐后同时释放
+				if (j == 0)
+				{
+					++ready;
+					while (!go.load(std::memory_order_acquire))
+						std::this_thread::yield();
+				}
+
+				auto begin = std::chrono::steady_clock::now();
+				for (size_t i = 0; i < ntimes; i++)
+				{
+					dealloc(v[i]);
+				}
+				auto end = std::chrono::steady_clock::now();
+
+				free_costtime += (size_t)std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+			}
+		});
+	}
+
+	while (ready.load() != nworks)
+		std::this_thread::yield();
+	go.store(true, std::memory_order_release);
+
+	for (auto& t : vthread)
+	{
+		t.join();
+	}
+
+	// 平均每个线程的释放耗时，折算成整体吞吐(百万次/秒)
+	double avg_us = (double)free_costtime.load() / nworks;
+	if (avg_us <= 0)
+		avg_us = 1;
+	return (double)(nworks * rounds * ntimes) / avg_us;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t n = 100000;
+	size_t rounds = 10;
+	size_t maxThreads = std::thread::hardware_concurrency() * 2;
+	if (argc > 1)
+		maxThreads = strtoul(argv[1], nullptr, 10);
+	if (maxThreads < 1)
+		maxThreads = 1;
+
+	cout << "==========================================================" << endl;
+	printf("%8s %24s %24s\n", "线程数", "concurrent free(Mops/s)", "free(Mops/s)");
+	for (size_t nworks = 1; nworks <= maxThreads; nworks *= 2)
+	{
+		double ours = BenchmarkFreeThroughput(n, nworks, rounds,
+			[](size_t size) { return ConcurrentAlloc(size); },
+			[](void* p) { ConcurrentFree(p); });
+		double sys = BenchmarkFreeThroughput(n, nworks, rounds,
+			[](size_t size) { return malloc(size); },
+			[](void* p) { free(p); });
+		printf("%8zu %24.2f %24.2f\n", nworks, ours, sys);
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+
+// 租户拆除基准：一个租户(请求、会话)申请大量大小不一的小对象，结束时整体回收。
+//  - 共享默认堆：只能逐个 ConcurrentFree
+//  - 独立堆：Heap::Destroy 一次把它的span全部 munmap
+// 对比拆除耗时，以及拆除后RSS是否真的降下来(默认堆的空闲页留在页缓存里)
+static double Ms(std::chrono::steady_clock::time_point begin)
+{
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+}
+
+void BenchmarkTeardown(size_t objects, size_t rounds)
+{
+	std::vector<void*> v(objects);
+	double sharedMs = 0, heapMs = 0;
+	size_t sharedRss = 0, heapRss = 0;
+
+	// 先跑独立堆：默认堆逐个释放后空闲页留在页缓存里，会一直算在RSS里
+	for (size_t r = 0; r < rounds; ++r)
+	{
+		Heap* heap = Heap::Create();
+		for (size_t i = 0; i < objects; ++i)
+			ConcurrentAlloc(heap, i * 37 % 2048 + 16);
+		auto begin = std::chrono::steady_clock::now();
+		Heap::Destroy(heap);
+		heapMs += Ms(begin);
+	}
+	heapRss = GetRSS();
+
+	for (size_t r = 0; r < rounds; ++r)
+	{
+		for (size_t i = 0; i < objects; ++i)
+			v[i] = ConcurrentAlloc(i * 37 % 2048 + 16);
+		auto begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < objects; ++i)
+			ConcurrentFree(v[i]);
+		sharedMs += Ms(begin);
+	}
+	sharedRss = GetRSS();
+
+	printf("%8zu个对象 x %2zu轮: 逐个释放 %8.2f ms (之后RSS %6.1f MB) | Heap::Destroy %8.2f ms (之后RSS %6.1f MB)\n",
+		objects, rounds, sharedMs, sharedRss / 1048576.0, heapMs, heapRss / 1048576.0);
+}
+
+int main()
+{
+	cout << "==========================================================" << endl;
+	BenchmarkTeardown(10000, 20);
+	BenchmarkTeardown(100000, 10);
+	BenchmarkTeardown(1000000, 5);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,149 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<random>
+#include<algorithm>
+#include<linux/perf_event.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+
+// 透明大页基准：在4KB页与 TCMALLOC_HUGEPAGE=1 的页缓存上各申请一批小对象，
+// 按随机顺序串成环后沿指针遍历，工作集远大于TLB覆盖范围时每一跳都可能TLB未命中。
+// 两种模式各用一个新建的 Heap(页缓存构造时读环境变量)，对比：
+//  - 遍历时的 dTLB 读未命中次数(硬件计数器，虚拟机里可能不可用)与每跳耗时
+//  - 申请并写满这些对象时的缺页次数，以及落在透明大页上的内存(AnonHugePages)
+static double Ms(std::chrono::steady_clock::time_point begin)
+{
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+}
+
+// 打开一个只统计本线程用户态的计数器，失败返回-1
+static int OpenCounter(unsigned type, unsigned long long config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void StartCounter(int fd)
+{
+	if (fd >= 0)
+	{
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+static long long StopCounter(int fd)
+{
+	long long value = -1;
+	if (fd >= 0)
+	{
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &value, sizeof(value)) != sizeof(value))
+			value = -1;
+	}
+	return value;
+}
+
+// 本进程落在透明大页上的匿名内存(字节)，读 /proc/self/smaps_rollup
+static size_t GetAnonHugePages()
+{
+	FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+	if (fp == nullptr)
+		return 0;
+	char line[256];
+	size_t kb = 0;
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (strncmp(line, "AnonHugePages:", 14) == 0)
+		{
+			sscanf(line + 14, "%zu", &kb);
+			break;
+		}
+	}
+	fclose(fp);
+	return kb * 1024;
+}
+
+static void* volatile chaseSink;
+
+void BenchmarkPointerChase(bool hugePage, size_t objects, size_t hops)
+{
+	if (hugePage)
+		setenv("TCMALLOC_HUGEPAGE", "1", 1);
+	Heap* heap = Heap::Create();
+	unsetenv("TCMALLOC_HUGEPAGE");
+
+	int faultFd = OpenCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+	int tlbFd = OpenCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+	// 32~256字节混合，写满对象使页真正分配
+	std::vector<void**> objs(objects);
+	size_t hugeBefore = GetAnonHugePages();
+	StartCounter(faultFd);
+	for (size_t i = 0; i < objects; ++i)
+	{
+		size_t size = 32 + (i * 37 % 8) * 32;
+		objs[i] = (void**)ConcurrentAlloc(heap, size);
+		memset(objs[i], 0, size);
+	}
+	long long faults = StopCounter(faultFd);
+	size_t hugeBytes = GetAnonHugePages() - hugeBefore;
+
+	// 随机顺序串成一个环
+	std::vector<size_t> order(objects);
+	for (size_t i = 0; i < objects; ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), std::mt19937(42));
+	for (size_t i = 0; i < objects; ++i)
+		*objs[order[i]] = objs[order[(i + 1) % objects]];
+
+	void** p = objs[order[0]];
+	StartCounter(tlbFd);
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < hops; ++i)
+		p = (void**)*p;
+	double ms = Ms(begin);
+	long long tlbMisses = StopCounter(tlbFd);
+	chaseSink = p;
+
+	char tlb[32];
+	if (tlbMisses >= 0)
+		snprintf(tlb, sizeof(tlb), "%lld", tlbMisses);
+	else
+		snprintf(tlb, sizeof(tlb), "不可用");
+	printf("%-8s %8zu个对象: 遍历%zu跳 %8.2f ms (%5.1f ns/跳, dTLB未命中 %s) | 缺页 %8lld | 大页上 %6.1f MB\n",
+		hugePage ? "2MB大页" : "4KB页", objects, hops, ms, ms * 1e6 / hops, tlb, faults,
+		hugeBytes / 1048576.0);
+
+	if (faultFd >= 0)
+		close(faultFd);
+	if (tlbFd >= 0)
+		close(tlbFd);
+	Heap::Destroy(heap);
+}
+
+int main()
+{
+	cout << "==========================================================" << endl;
+	for (size_t objects : { (size_t)1 << 18, (size_t)1 << 20, (size_t)1 << 22 })
+	{
+		BenchmarkPointerChase(false, objects, 20000000);
+		BenchmarkPointerChase(true, objects, 20000000);
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<random>
+#include<sys/resource.h>
+
+// 超大span缓存基准：反复申请、写满、释放 1~8MB 的缓冲区(同时留着几个)，
+// 对比不缓存(TCMALLOC_LARGE_CACHE_BYTES=0，每次 mmap+munmap)与默认保留上限(还页速度也是默认的)：
+//  - 每轮申请+写满+释放的耗时
+//  - 缺页次数(每次新 mmap 的页第一次写都要缺页)
+// 两种方式各用一个新建的 Heap(页缓存构造时读环境变量)
+static double Ms(std::chrono::steady_clock::time_point begin)
+{
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+}
+
+static long MinorFaults()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_minflt;
+}
+
+void BenchmarkLargeCache(bool cache, size_t rounds, size_t live)
+{
+	if (!cache)
+		setenv("TCMALLOC_LARGE_CACHE_BYTES", "0", 1);
+	Heap* heap = Heap::Create();
+	unsetenv("TCMALLOC_LARGE_CACHE_BYTES");
+
+	std::mt19937 rng(7);
+	std::vector<char*> bufs(live, nullptr);
+	long faults = MinorFaults();
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < rounds; ++i)
+	{
+		char*& slot = bufs[rng() % live];
+		if (slot)
+			ConcurrentFree(heap, slot);
+		size_t size = ((size_t)1 << 20) + rng() % ((size_t)7 << 20);
+		slot = (char*)ConcurrentAlloc(heap, size);
+		memset(slot, (int)i, size);
+	}
+	double ms = Ms(begin);
+	faults = MinorFaults() - faults;
+	for (char* p : bufs)
+		ConcurrentFree(heap, p);
+
+	printf("%-10s %6zu轮(同时留%zu个): %8.2f ms (%7.1f us/轮) | 缺页 %8ld\n",
+		cache ? "缓存" : "mmap+munmap", rounds, live, ms, ms * 1000 / rounds, faults);
+	Heap::Destroy(heap);
+}
+
+int main()
+{
+	cout << "==========================================================" << endl;
+	for (size_t live : { (size_t)1, (size_t)8 })
+	{
+		BenchmarkLargeCache(false, 2000, live);
+		BenchmarkLargeCache(true, 2000, live);
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
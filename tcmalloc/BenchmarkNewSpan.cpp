@@ -0,0 +1,95 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<chrono>
+#include<vector>
+#include<random>
+
+// 页缓存切分路径基准：在一个碎片化的页缓存上反复 NewSpan，统计每次 NewSpan 的耗时，
+// 也就是持页缓存锁的时间(锁由调用者持有，这里只计 NewSpan 本身)
+//  - 大洞：空闲的只有被在用的1页隔开的127页span，小的申请在精确链表落空后要往后找到127页才能切
+//  - 随机碎片：随机大小的span释放一半，空闲链表零散分布
+// 每批申请的span计时结束后立即还回，合并回原来的形状
+static void Measure(PageCache* pc, const char* name, std::mt19937& rng, size_t maxK, size_t rounds)
+{
+	std::uniform_int_distribution<size_t> dist(1, maxK);
+	std::vector<Span*> spans;
+	std::vector<size_t> ks(16);
+	double ns = 0;
+	size_t calls = 0;
+	for (size_t r = 0; r < rounds; ++r)
+	{
+		for (size_t& k : ks)
+			k = dist(rng);
+		auto begin = std::chrono::steady_clock::now();
+		for (size_t k : ks)
+			spans.push_back(pc->NewSpan(k));
+		ns += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - begin).count();
+		calls += ks.size();
+		// 先都标成在用，还回时才不会把同批还没还的当成空闲邻居合并
+		for (Span* span : spans)
+			span->_isUse = true;
+		for (Span* span : spans)
+			pc->ReleaseSpanToPageCache(span);
+		spans.clear();
+	}
+	printf("%-10s k=1~%-3zu %8zu次 NewSpan: 平均 %6.1f ns/次\n", name, maxK, calls, ns / calls);
+}
+
+void BenchmarkNewSpanHoles(size_t holes, size_t rounds)
+{
+	Heap* heap = Heap::Create();
+	PageCache* pc = heap->GetPageCache();
+	{
+		std::lock_guard<std::mutex> lg(pc->Getmtx());
+		std::vector<Span*> free;
+		for (size_t i = 0; i < holes; ++i)
+		{
+			free.push_back(pc->NewSpan(NPAGES - 2));
+			free.back()->_isUse = true;
+			pc->NewSpan(1)->_isUse = true;
+		}
+		for (Span* span : free)
+			pc->ReleaseSpanToPageCache(span);
+		std::mt19937 rng(1);
+		Measure(pc, "大洞", rng, 8, rounds);
+	}
+	Heap::Destroy(heap);
+}
+
+void BenchmarkNewSpanRandom(size_t spans, size_t rounds)
+{
+	Heap* heap = Heap::Create();
+	PageCache* pc = heap->GetPageCache();
+	{
+		std::lock_guard<std::mutex> lg(pc->Getmtx());
+		std::mt19937 rng(2);
+		std::uniform_int_distribution<size_t> dist(1, 64);
+		std::vector<Span*> all;
+		for (size_t i = 0; i < spans; ++i)
+		{
+			all.push_back(pc->NewSpan(dist(rng)));
+			all.back()->_isUse = true;
+		}
+		for (size_t i = 0; i < spans; ++i)
+		{
+			if (rng() % 2)
+				pc->ReleaseSpanToPageCache(all[i]);
+		}
+		Measure(pc, "随机碎片", rng, 16, rounds);
+	}
+	Heap::Destroy(heap);
+}
+
+int main()
+{
+	// 不让释放span时顺带还页干扰计时
+	PageCache::SetReleaseRate(0);
+	cout << "==========================================================" << endl;
+	BenchmarkNewSpanHoles(4096, 100000);
+	BenchmarkNewSpanRandom(100000, 100000);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<thread>
+#include<atomic>
+#include<condition_variable>
+#include<sys/wait.h>
+
+// 高线程数下比较每CPU缓存与每线程缓存：
+// 每个线程反复申请/释放一批不同大小的对象，做完后不退出，停在屏障上，
+// 此时各前端缓存里囤积的对象都还在，读取进程RSS；再统计整体吞吐。
+// 两种前端分别在 fork 出的子进程里运行，互不影响RSS。
+void BenchmarkFrontEnd(const char* name, size_t nworks, size_t rounds, size_t batch)
+{
+	std::vector<std::thread> vthread(nworks);
+	std::atomic<size_t> done(0);
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool release = false;
+
+	size_t rss_begin = GetRSS();
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		vthread[k] = std::thread([&, k]() {
+			void* v[256];
+			for (size_t j = 0; j < rounds; ++j)
+			{
+				for (size_t i = 0; i < batch; i++)
+				{
+					v[i] = ConcurrentAlloc(((i + k) * 40) % 4096 + 8);
+				}
+				for (size_t i = 0; i < batch; i++)
+				{
+					ConcurrentFree(v[i]);
+				}
+			}
+
+			++done;
+			std::unique_lock<std::mutex> ul(mtx);
+			cv.wait(ul, [&]() { return release; });
+		});
+	}
+
+	while (done.load() != nworks)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	auto end = std::chrono::steady_clock::now();
+	size_t rss_end = GetRSS();
+
+	{
+		std::lock_guard<std::mutex> lg(mtx);
+		release = true;
+	}
+	cv.notify_all();
+	for (auto& t : vthread)
+	{
+		t.join();
+	}
+
+	size_t ms = (size_t)std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+	if (ms == 0)
+		ms = 1;
+	printf("%-10s %zu个线程 每线程%zu轮x%zu对象: 耗时 %zu ms, 吞吐 %.2f Mops/s, 线程存活时RSS增长 %.1f MB\n",
+		name, nworks, rounds, batch, ms,
+		(double)(nworks * rounds * batch * 2) / ms / 1000,
+		(double)(rss_end - rss_begin) / (1024 * 1024));
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nworks = 2000;
+	if (argc > 1)
+		nworks = strtoul(argv[1], nullptr, 10);
+
+	const char* modes[2][2] = { { "per-cpu", "1" }, { "per-thread", "0" } };
+	cout << "==========================================================" << endl;
+	for (auto& mode : modes)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			setenv("TCMALLOC_PERCPU", mode[1], 1);
+			BenchmarkFrontEnd(mode[0], nworks, 100, 64);
+			fflush(stdout);
+			_exit(0);
+		}
+		waitpid(pid, nullptr, 0);
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
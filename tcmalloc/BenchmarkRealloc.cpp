@@ -0,0 +1,81 @@
+#include"ConcurrentAlloc.h"
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<chrono>
+#include<vector>
+
+// realloc 基准：模拟不断追加数据的缓冲区(vector/字符串拼接)，
+// 对比 ConcurrentRealloc 与 glibc realloc 的耗时，以及其中有多少次换了地址(需要复制)。
+//  - 倍增：每次容量翻倍，直到 maxBytes
+//  - 线性：每次多 step 字节，大量落在页级span上，主要看原地吞并相邻空闲页的效果
+// 每次扩容后写入新增部分，模拟真实的追加
+struct ReallocResult
+{
+	double _ms;
+	size_t _calls;
+	size_t _moves;
+};
+
+template<class ReallocFn, class FreeFn>
+ReallocResult GrowBuffers(size_t buffers, size_t maxBytes, bool doubling, size_t step,
+	ReallocFn re, FreeFn fr)
+{
+	ReallocResult res{ 0, 0, 0 };
+	std::vector<void*> bufs(buffers, nullptr);
+	std::vector<size_t> caps(buffers, 0);
+
+	auto begin = std::chrono::steady_clock::now();
+	bool growing = true;
+	while (growing)
+	{
+		growing = false;
+		// 多个缓冲区交替增长，相邻的空闲页不会总是留给同一个缓冲区
+		for (size_t i = 0; i < buffers; ++i)
+		{
+			if (caps[i] >= maxBytes)
+				continue;
+			size_t cap = caps[i] == 0 ? 16 : (doubling ? caps[i] * 2 : caps[i] + step);
+			void* p = re(bufs[i], cap);
+			if (p != bufs[i] && bufs[i] != nullptr)
+				++res._moves;
+			++res._calls;
+			memset((char*)p + caps[i], (int)i, cap - caps[i]);
+			bufs[i] = p;
+			caps[i] = cap;
+			growing = true;
+		}
+	}
+	res._ms = (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+
+	for (void* p : bufs)
+		fr(p);
+	return res;
+}
+
+void BenchmarkRealloc(const char* name, size_t buffers, size_t maxBytes, bool doubling, size_t step)
+{
+	ReallocResult ours = GrowBuffers(buffers, maxBytes, doubling, step,
+		[](void* p, size_t n) { return ConcurrentRealloc(p, n); },
+		[](void* p) { ConcurrentFree(p); });
+	ReallocResult sys = GrowBuffers(buffers, maxBytes, doubling, step,
+		[](void* p, size_t n) { return realloc(p, n); },
+		[](void* p) { free(p); });
+
+	printf("%-28s ConcurrentRealloc %8.2f ms (%zu次, 换地址%zu次) | realloc %8.2f ms (%zu次, 换地址%zu次)\n",
+		name, ours._ms, ours._calls, ours._moves, sys._ms, sys._calls, sys._moves);
+}
+
+int main()
+{
+	cout << "==========================================================" << endl;
+	BenchmarkRealloc("倍增 64个缓冲区 至1MB", 64, 1 << 20, true, 0);
+	BenchmarkRealloc("倍增 4个缓冲区 至64MB", 4, 64 << 20, true, 0);
+	BenchmarkRealloc("线性+4KB 16个缓冲区 至256KB", 16, 256 << 10, false, 4096);
+	BenchmarkRealloc("线性+1KB 4个缓冲区 至256KB", 4, 256 << 10, false, 1024);
+	BenchmarkRealloc("线性+64KB 2个缓冲区 至32MB", 2, 32 << 20, false, 64 << 10);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
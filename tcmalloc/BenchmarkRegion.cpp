@@ -0,0 +1,67 @@
+#include"ConcurrentAlloc.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<string>
+#include<vector>
+#include<unordered_map>
+#include<memory_resource>
+
+// 请求级临时内存基准：每个“请求”建一个 pmr 哈希表和若干字符串、数组，用完整体丢掉。
+//  - new_delete_resource：逐个 new/delete(本程序没有替换 operator new，走 glibc)
+//  - monotonic_buffer_resource：标准库的单调分配器，上游是 new_delete_resource
+//  - RegionResource：向页缓存整块要span的单调分配器，请求结束 Reset 一次性归还
+static size_t HandleRequest(std::pmr::memory_resource* mr, size_t keys)
+{
+	std::pmr::unordered_map<std::pmr::string, std::pmr::vector<int>> table(mr);
+	for (size_t i = 0; i < keys; ++i)
+	{
+		std::pmr::string key("request-key-with-some-length-", mr);
+		key += std::to_string(i);
+		auto& v = table[key];
+		for (size_t j = 0; j < i % 16 + 1; ++j)
+			v.push_back((int)j);
+	}
+	return table.size();
+}
+
+template<class Fn>
+static double Measure(size_t requests, Fn fn)
+{
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < requests; ++r)
+		fn();
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+}
+
+void BenchmarkRegion(size_t requests, size_t keys)
+{
+	size_t sink = 0;
+	double sys = Measure(requests, [&]() {
+		sink += HandleRequest(std::pmr::new_delete_resource(), keys);
+	});
+	double mono = Measure(requests, [&]() {
+		std::pmr::monotonic_buffer_resource res;
+		sink += HandleRequest(&res, keys);
+	});
+	RegionResource region;
+	double ours = Measure(requests, [&]() {
+		sink += HandleRequest(&region, keys);
+		region.Reset();
+	});
+
+	printf("%6zu个请求 x %5zu个键: new/delete %8.2f ms | monotonic_buffer_resource %8.2f ms | RegionResource %8.2f ms (%zu)\n",
+		requests, keys, sys, mono, ours, sink / 3 / requests);
+}
+
+int main()
+{
+	cout << "==========================================================" << endl;
+	BenchmarkRegion(20000, 10);
+	BenchmarkRegion(2000, 1000);
+	BenchmarkRegion(20, 100000);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
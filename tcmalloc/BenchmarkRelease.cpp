@@ -0,0 +1,121 @@
+#include"ConcurrentAlloc.h"
+#include"Scavenger.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<chrono>
+#include<thread>
+#include<vector>
+
+// 空闲页还给系统的基准：申请一波大块(300KB~500KB，走页缓存)并写满，全部释放后看进程占用的物理内存(RSS)
+//  - 不还：还页速度为0
+//  - 显式：释放后调用 ConcurrentReleaseFreeMemory，记录耗时
+//  - 顺带：按速度在释放span时顺带还，释放后继续小量申请释放一段时间
+//  - 后台：StartScavenger 按速度还，释放后等一段时间
+// 每种方式再来一波同样的申请，对比还过的页重新使用的耗时
+static double Ms(std::chrono::steady_clock::time_point begin)
+{
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+}
+
+static double RssMB()
+{
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (fp == nullptr)
+		return 0;
+	unsigned long vsz = 0, rss = 0;
+	if (fscanf(fp, "%lu %lu", &vsz, &rss) != 2)
+		rss = 0;
+	fclose(fp);
+	return (double)rss * sysconf(_SC_PAGESIZE) / 1048576;
+}
+
+// 申请并写满一波共 bytes 字节，返回耗时
+static double Spike(std::vector<char*>& v, size_t bytes)
+{
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t total = 0, i = 0; total < bytes; ++i)
+	{
+		size_t size = 300 * 1024 + i * 7919 % (200 * 1024);
+		char* p = (char*)ConcurrentAlloc(size);
+		memset(p, (int)i, size);
+		v.push_back(p);
+		total += size;
+	}
+	return Ms(begin);
+}
+
+static void FreeAll(std::vector<char*>& v)
+{
+	for (char* p : v)
+		ConcurrentFree(p);
+	v.clear();
+}
+
+enum Mode { NONE, EXPLICIT, AMORTIZED, BACKGROUND };
+
+void BenchmarkRelease(Mode mode, size_t bytes, size_t rate, size_t waitMs)
+{
+	static const char* names[] = { "不还", "显式调用", "释放时顺带", "后台线程" };
+	std::vector<char*> v;
+	v.reserve(bytes / (300 * 1024) + 1);
+	ConcurrentReleaseFreeMemory();
+
+	PageCache::SetReleaseRate(mode == AMORTIZED || mode == BACKGROUND ? rate : 0);
+	if (mode == BACKGROUND)
+		StartScavenger(100);
+
+	double spikeMs = Spike(v, bytes);
+	double rssPeak = RssMB();
+	FreeAll(v);
+	double rssFreed = RssMB();
+
+	double releaseMs = 0;
+	if (mode == EXPLICIT)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		ConcurrentReleaseFreeMemory();
+		releaseMs = Ms(begin);
+	}
+	else if (mode == AMORTIZED)
+	{
+		// 小量申请释放，让释放span的路径有机会顺带还页
+		auto begin = std::chrono::steady_clock::now();
+		while (Ms(begin) < waitMs)
+		{
+			ConcurrentFree(ConcurrentAlloc(400 * 1024));
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	else if (mode == BACKGROUND)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+	}
+	double rssAfter = RssMB();
+
+	if (mode == BACKGROUND)
+		StopScavenger();
+	PageCache::SetReleaseRate(0);
+
+	double respikeMs = Spike(v, bytes);
+	FreeAll(v);
+
+	printf("%-10s 峰值 %7.1f MB | 释放后 %7.1f MB | %4zums后 %7.1f MB (还页 %6.2f ms) | 首波 %7.2f ms, 再来一波 %7.2f ms\n",
+		names[mode], rssPeak, rssFreed, mode == EXPLICIT || mode == NONE ? (size_t)0 : waitMs, rssAfter,
+		releaseMs, spikeMs, respikeMs);
+}
+
+int main()
+{
+	const size_t bytes = (size_t)512 << 20;
+	const size_t rate = (size_t)1 << 30;
+	cout << "==========================================================" << endl;
+	cout << "一波 " << (bytes >> 20) << "MB，按速度还页 " << (rate >> 20) << "MB/s" << endl;
+	BenchmarkRelease(NONE, bytes, rate, 0);
+	BenchmarkRelease(EXPLICIT, bytes, rate, 0);
+	BenchmarkRelease(AMORTIZED, bytes, rate, 1000);
+	BenchmarkRelease(BACKGROUND, bytes, rate, 1000);
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<algorithm>
+
+// 页缓存补货方式基准：逐次 mmap 512KB(TCMALLOC_RESERVE_BYTES=0) 与预留地址分段提交的对比。
+// 两种方式各用一个新建的 Heap(页缓存在首次补货时读环境变量)，申请一批大小不一的对象，对比
+//  - 申请耗时与拿到的地址跨度(最高-最低地址 / 实际占用)
+//  - 进程的内存映射(VMA)个数
+//  - Heap::Destroy 耗时(页号映射扫描的范围随页号跨度变化)
+static double Ms(std::chrono::steady_clock::time_point begin)
+{
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+}
+
+// /proc/self/maps 的行数
+static size_t CountMappings()
+{
+	FILE* fp = fopen("/proc/self/maps", "r");
+	if (fp == nullptr)
+		return 0;
+	size_t n = 0;
+	int c;
+	while ((c = fgetc(fp)) != EOF)
+		n += c == '\n';
+	fclose(fp);
+	return n;
+}
+
+void BenchmarkReserve(bool reserve, size_t objects)
+{
+	setenv("TCMALLOC_RESERVE_BYTES", reserve ? "4294967296" : "0", 1);
+	Heap* heap = Heap::Create();
+
+	std::vector<char*> v(objects);
+	size_t mapsBefore = CountMappings();
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < objects; ++i)
+		v[i] = (char*)ConcurrentAlloc(heap, i * 37 % 4096 + 16);
+	double allocMs = Ms(begin);
+	size_t maps = CountMappings() - mapsBefore;
+	unsetenv("TCMALLOC_RESERVE_BYTES");
+
+	char* lo = *std::min_element(v.begin(), v.end());
+	char* hi = *std::max_element(v.begin(), v.end());
+	size_t used = 0;
+	for (size_t i = 0; i < objects; ++i)
+		used += SizeClass::RoundUp(i * 37 % 4096 + 16);
+
+	begin = std::chrono::steady_clock::now();
+	Heap::Destroy(heap);
+	double destroyMs = Ms(begin);
+
+	printf("%-14s %8zu个对象: 申请 %8.2f ms | 地址跨度/占用 %6.2f | 新增映射 %4zu | Destroy %7.2f ms\n",
+		reserve ? "预留分段提交" : "逐次mmap", objects, allocMs, (double)(hi - lo) / used, maps, destroyMs);
+}
+
+int main()
+{
+	cout << "==========================================================" << endl;
+	for (size_t objects : { (size_t)100000, (size_t)1000000 })
+	{
+		BenchmarkReserve(false, objects);
+		BenchmarkReserve(true, objects);
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<thread>
+#include<atomic>
+#include<sys/wait.h>
+
+// 突发型服务：线程先集中申请释放一大批对象，之后长时间空闲
+// (每线程缓存：只有零星的小请求；每CPU缓存：线程直接阻塞)。
+// 对比开启/关闭后台回收线程时，前端缓存在空闲期结束时还囤积多少字节。
+static size_t FrontCachedBytes()
+{
+	return ThreadCache::TotalCachedBytes() + CpuCache::TotalCachedBytes();
+}
+
+void BenchmarkBurstThenIdle(const char* name, bool perCpu, bool scavenger, size_t nworks, size_t idleMs)
+{
+	if (scavenger)
+		StartScavenger(50);
+
+	std::vector<std::thread> vthread(nworks);
+	std::atomic<size_t> burstDone(0);
+	std::atomic<bool> quit(false);
+
+	for (size_t k = 0; k < nworks; ++k)
+	{
+		vthread[k] = std::thread([&, k]() {
+			std::vector<void*> v(20000);
+			for (size_t i = 0; i < v.size(); i++)
+			{
+				v[i] = ConcurrentAlloc(((i + k) * 56) % 1024 + 16);
+			}
+			for (size_t i = 0; i < v.size(); i++)
+			{
+				ConcurrentFree(v[i]);
+			}
+			++burstDone;
+
+			while (!quit)
+			{
+				// 每CPU缓存场景下线程彻底不动；每线程缓存场景下偶尔有零星请求
+				if (!perCpu)
+					ConcurrentFree(ConcurrentAlloc(64));
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	while (burstDone.load() != nworks)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	size_t afterBurst = FrontCachedBytes();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(idleMs));
+	size_t afterIdle = FrontCachedBytes();
+
+	quit = true;
+	for (auto& t : vthread)
+	{
+		t.join();
+	}
+	if (scavenger)
+		StopScavenger();
+
+	printf("%-12s 后台回收%s: 突发后前端缓存 %8.1f KB, 空闲%zums后 %8.1f KB, RSS %.1f MB\n",
+		name, scavenger ? "开" : "关",
+		(double)afterBurst / 1024, idleMs, (double)afterIdle / 1024,
+		(double)GetRSS() / (1024 * 1024));
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nworks = 8;
+	if (argc > 1)
+		nworks = strtoul(argv[1], nullptr, 10);
+
+	cout << "==========================================================" << endl;
+	for (int perCpu = 0; perCpu < 2; ++perCpu)
+	{
+		for (int scavenger = 0; scavenger < 2; ++scavenger)
+		{
+			pid_t pid = fork();
+			if (pid == 0)
+			{
+				setenv("TCMALLOC_PERCPU", perCpu ? "1" : "0", 1);
+				BenchmarkBurstThenIdle(perCpu ? "per-cpu" : "per-thread", perCpu, scavenger, nworks, 1000);
+				fflush(stdout);
+				_exit(0);
+			}
+			waitpid(pid, nullptr, 0);
+		}
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
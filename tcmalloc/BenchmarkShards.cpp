@@ -0,0 +1,81 @@
+#include"ConcurrentAlloc.h"
+#include"BenchmarkUtil.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<thread>
+#include<vector>
+#include<sys/resource.h>
+
+// 页缓存锁争用基准：多个线程各自申请一大批跨很多尺寸类别的对象再全部释放，
+// 工作集远超线程缓存，中心缓存不断向页缓存补货、归还整span。
+// 对比关闭分片(TCMALLOC_SPAN_SHARDS=0，每次补货/归还都拿页缓存锁)与按CPU分片，
+// 两种方式各用一个新建的 Heap(页缓存构造时读环境变量)。除了耗时还统计主动让出CPU的次数：
+// 拿不到锁睡下去会记一次，CPU少时耗时看不出争用，这个数能看出来
+static long VoluntarySwitches()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_nvcsw;
+}
+
+static double Ms(std::chrono::steady_clock::time_point begin)
+{
+	return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - begin).count() / 1000;
+}
+
+void BenchmarkShards(bool sharded, size_t nthreads, size_t objects, size_t rounds)
+{
+	if (!sharded)
+		setenv("TCMALLOC_SPAN_SHARDS", "0", 1);
+	Heap* heap = Heap::Create();
+	unsetenv("TCMALLOC_SPAN_SHARDS");
+
+	long switches = VoluntarySwitches();
+	auto begin = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nthreads; ++t)
+	{
+		threads.emplace_back([heap, t, objects, rounds]() {
+			std::vector<void*> v(objects);
+			for (size_t r = 0; r < rounds; ++r)
+			{
+				// 每个线程错开类别，16B~8KB 之间轮着来
+				for (size_t i = 0; i < objects; ++i)
+				{
+					size_t size = 16 + ((i * 7 + t * 131 + r * 17) % 512) * 16;
+					v[i] = ConcurrentAlloc(heap, size);
+					*(char*)v[i] = (char)i;
+				}
+				for (size_t i = 0; i < objects; ++i)
+					ConcurrentFree(heap, v[i]);
+			}
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	double ms = Ms(begin);
+	switches = VoluntarySwitches() - switches;
+
+	printf("%-8s %3zu线程 x %zu轮 x %zu个对象: %9.2f ms (%6.1f ns/次申请+释放) | 主动切换 %8ld\n",
+		sharded ? "分片" : "不分片", nthreads, rounds, objects, ms,
+		ms * 1e6 / ((double)nthreads * rounds * objects), switches);
+	Heap::Destroy(heap);
+}
+
+int main()
+{
+	// 不让按速度还页干扰
+	PageCache::SetReleaseRate(0);
+	cout << "==========================================================" << endl;
+	cout << "CPU个数: " << std::thread::hardware_concurrency() << endl;
+	for (size_t nthreads : { (size_t)1, (size_t)4, (size_t)16 })
+	{
+		BenchmarkShards(false, nthreads, 5000, 20);
+		BenchmarkShards(true, nthreads, 5000, 20);
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
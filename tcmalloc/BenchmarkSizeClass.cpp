@@ -0,0 +1,99 @@
+#include"ConcurrentAlloc.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<random>
+
+// 大小->桶号->对象大小映射的微基准，以及 ConcurrentAlloc/ConcurrentFree 快路径耗时
+
+// 查表之前的分支链实现，仅用作对照
+struct BranchSizeClass
+{
+	static inline size_t _RoundUp(size_t bytes, size_t alignNum)
+	{
+		return ((bytes + alignNum - 1) & ~(alignNum - 1));
+	}
+
+	static inline size_t RoundUp(size_t size)
+	{
+		if (size <= 128) return _RoundUp(size, 8);
+		else if (size <= 1024) return _RoundUp(size, 16);
+		else if (size <= 8 * 1024) return _RoundUp(size, 128);
+		else if (size <= 64 * 1024) return _RoundUp(size, 1024);
+		else return _RoundUp(size, 8 * 1024);
+	}
+
+	static inline size_t _Index(size_t bytes, size_t align_shift)
+	{
+		return ((bytes + (1 << align_shift) - 1) >> align_shift) - 1;
+	}
+
+	static inline size_t Index(size_t bytes)
+	{
+		static int group_array[4] = { 16, 56, 56, 56 };
+		if (bytes <= 128) return _Index(bytes, 3);
+		else if (bytes <= 1024) return _Index(bytes - 128, 4) + group_array[0];
+		else if (bytes <= 8 * 1024) return _Index(bytes - 1024, 7) + group_array[1] + group_array[0];
+		else if (bytes <= 64 * 1024) return _Index(bytes - 8 * 1024, 10) + group_array[2] + group_array[1] + group_array[0];
+		else return _Index(bytes - 64 * 1024, 13) + group_array[3] + group_array[2] + group_array[1] + group_array[0];
+	}
+};
+
+template<class SC>
+double BenchmarkMapping(const std::vector<size_t>& sizes, size_t rounds, size_t& sink)
+{
+	auto begin = std::chrono::steady_clock::now();
+	size_t sum = 0;
+	for (size_t j = 0; j < rounds; ++j)
+	{
+		for (size_t size : sizes)
+		{
+			sum += SC::Index(size) + SC::RoundUp(size);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	sink += sum;
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / (rounds * sizes.size());
+}
+
+double BenchmarkFastPath(size_t size, size_t ntimes)
+{
+	// 预热：让对应的自由链表里先有对象
+	ConcurrentFree(ConcurrentAlloc(size));
+
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ntimes; ++i)
+	{
+		void* p = ConcurrentAlloc(size);
+		ConcurrentFree(p);
+	}
+	auto end = std::chrono::steady_clock::now();
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / ntimes;
+}
+
+int main()
+{
+	// 大小分布偏向小对象：八成不超过1KB
+	std::mt19937 rng(12345);
+	std::vector<size_t> sizes(1 << 16);
+	for (auto& size : sizes)
+	{
+		size = rng() % 10 < 8 ? rng() % 1024 + 1 : rng() % MAX_BYTES + 1;
+	}
+
+	size_t sink = 0;
+	cout << "==========================================================" << endl;
+	printf("大小映射(Index+RoundUp): 查表 %.2f ns/次, 分支链 %.2f ns/次\n",
+		BenchmarkMapping<SizeClass>(sizes, 200, sink),
+		BenchmarkMapping<BranchSizeClass>(sizes, 200, sink));
+
+	for (size_t size : { 16, 128, 1000, 4000, 100 * 1024 })
+	{
+		printf("快路径 ConcurrentAlloc+ConcurrentFree(%6zu字节): %.2f ns/对\n",
+			size, BenchmarkFastPath(size, 10000000));
+	}
+	cout << "==========================================================" << endl;
+
+	return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+#include"ConcurrentAlloc.h"
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<vector>
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<sys/wait.h>
+
+// 生产者/消费者基准：生产者线程只申请，把对象按块交给消费者线程，消费者只释放。
+// 对象总是在别的线程被释放，生产者的线程缓存要不断补货，消费者的线程缓存不断溢出；
+// 没有中转缓存时每一批都要在CentralCache的桶锁下按span拆分再切出来，
+// 有中转缓存时消费者还回的整批直接被生产者取走。
+// 开/关中转缓存分别在 fork 出的子进程里运行(TCMALLOC_TRANSFER_CACHE)。
+static const size_t CHUNK = 1024;    // 生产者一次交出的对象数
+static const size_t MAX_QUEUED = 4;  // 队列里最多积压的块数
+
+void BenchmarkProducerConsumer(size_t pairs, size_t size, size_t chunksPerProducer)
+{
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<std::vector<void*>> queue;
+	size_t producersLeft = pairs;
+
+	auto begin = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (size_t k = 0; k < pairs; ++k)
+	{
+		threads.emplace_back([&]() {
+			for (size_t c = 0; c < chunksPerProducer; ++c)
+			{
+				std::vector<void*> chunk(CHUNK);
+				for (size_t i = 0; i < CHUNK; ++i)
+					chunk[i] = ConcurrentAlloc(size);
+
+				std::unique_lock<std::mutex> ul(mtx);
+				cv.wait(ul, [&]() { return queue.size() < MAX_QUEUED; });
+				queue.push_back(std::move(chunk));
+				cv.notify_all();
+			}
+			std::lock_guard<std::mutex> lg(mtx);
+			--producersLeft;
+			cv.notify_all();
+		});
+
+		threads.emplace_back([&]() {
+			for (;;)
+			{
+				std::vector<void*> chunk;
+				{
+					std::unique_lock<std::mutex> ul(mtx);
+					cv.wait(ul, [&]() { return !queue.empty() || producersLeft == 0; });
+					if (queue.empty())
+						return;
+					chunk = std::move(queue.front());
+					queue.pop_front();
+					cv.notify_all();
+				}
+				for (void* p : chunk)
+					ConcurrentFree(p, size);
+			}
+		});
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	size_t ms = (size_t)std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+	if (ms == 0)
+		ms = 1;
+	printf("%2zu对生产者/消费者 %6zu字节: 耗时 %5zu ms, 吞吐 %.2f M对象/s\n",
+		pairs, size, ms, (double)(pairs * chunksPerProducer * CHUNK) / ms / 1000);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t maxPairs = 4;
+	if (argc > 1)
+		maxPairs = strtoul(argv[1], nullptr, 10);
+
+	const char* modes[2][2] = { { "开启中转缓存", "1" }, { "关闭中转缓存", "0" } };
+	const size_t sizes[] = { 64, 1024 };
+	cout << "==========================================================" << endl;
+	for (auto& mode : modes)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			setenv("TCMALLOC_TRANSFER_CACHE", mode[1], 1);
+			printf("%s\n", mode[0]);
+			for (size_t size : sizes)
+			{
+				for (size_t pairs = 1; pairs <= maxPairs; pairs *= 2)
+					BenchmarkProducerConsumer(pairs, size, 2000);
+			}
+			fflush(stdout);
+			_exit(0);
+		}
+		waitpid(pid, nullptr, 0);
+	}
+	cout << "==========================================================" << endl;
+
+	return 0;
+}
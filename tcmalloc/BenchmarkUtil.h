@@ -0,0 +1,39 @@
+#pragma once
+#include<cstdio>
+#include<cstring>
+#include<unistd.h>
+
+// 基准程序共用的小工具
+
+// 当前进程常驻内存(字节)，读 /proc/self/statm 第二列
+static inline size_t GetRSS()
+{
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (fp == nullptr)
+		return 0;
+	unsigned long vsz = 0, rss = 0;
+	if (fscanf(fp, "%lu %lu", &vsz, &rss) != 2)
+		rss = 0;
+	fclose(fp);
+	return (size_t)rss * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// 进程常驻内存峰值(字节)，读 /proc/self/status 的 VmHWM
+static inline size_t GetPeakRSS()
+{
+	FILE* fp = fopen("/proc/self/status", "r");
+	if (fp == nullptr)
+		return 0;
+	char line[256];
+	size_t kb = 0;
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (strncmp(line, "VmHWM:", 6) == 0)
+		{
+			sscanf(line + 6, "%zu", &kb);
+			break;
+		}
+	}
+	fclose(fp);
+	return kb * 1024;
+}
@@ -1,8 +1,6 @@
 #include "CentralCache.h"
 
 
-CentralCache CentralCache::_sInst;
-
 Span *CentralCache::GetOneSpan(SpanList &list, size_t size) {
     Span* it = list.Begin();
     while(it != list.End()) {
@@ -16,14 +14,9 @@ Span *CentralCache::GetOneSpan(SpanList &list, size_t size) {
     //此时没有空闲的向下层要
     list._mtx.unlock(); //先把上一层的锁解开
 
-    PageCache::GetInstance()->Getmtx().lock();//给pagecache加锁
-
-    Span* span = PageCache::GetInstance()->NewSpan(SizeClass::NumMovePage(size)); //取得一块k页的span
-    
-    span->_isUse = true;
-    span->_objSize = size;
-
-    PageCache::GetInstance()->Getmtx().unlock();
+    //取得一块k页的span，超过一页的2的幂类别要求span按类别大小对齐；大页模式下按类别范围从各自的大页里切。
+    //先从页缓存当前CPU的分片取，分片空了才去拿页缓存锁
+    Span* span = _pageCache->NewSmallSpan(size);
 
     //对span进行切分
     char* start = (char*)(span->_pageId << PAGE_SHIFT);
@@ -35,7 +28,7 @@ Span *CentralCache::GetOneSpan(SpanList &list, size_t size) {
     void* tail = span->_freeList;
 
     int i = 1;
-    while(start < end)
+    while(start + size <= end) // 尾部不足一个对象的部分不切
     {
         ++i;
         NextObj(tail) = start;
@@ -76,64 +69,39 @@ size_t CentralCache::FetchRangeObj(void *&start, void *&end, size_t batchNum, si
     NextObj(end) = nullptr;
     //更新span使用计数
     span->_useCount += actualNum;
-    span->_objSize = size;
     _spanList[index]._mtx.unlock();
 
     return actualNum;
 
 }
 
-//归还内存到span（按Span分组，减少锁切换）
+//归还内存到span
+//MapObjToSpan 无锁，这里只需持有桶锁，不再需要先在PageCache锁下按span分组
 void CentralCache::ReleaseListToSpans(void* start, size_t size) 
 {
-    const int index = SizeClass::Index(size);
-
-    // 1) 在PageCache锁下，将对象链按Span分组，形成每组的start/end与计数
-    std::unordered_map<Span*, void*> groupStart;
-    std::unordered_map<Span*, void*> groupEnd;
-    std::unordered_map<Span*, size_t> groupCount;
+    const size_t index = SizeClass::Index(size);
+    _spanList[index]._mtx.lock();
 
-    PageCache::GetInstance()->Getmtx().lock();
-    void* cur = start;
-    while (cur)
+    //链表里连续属于同一个span的一段(批量申请/释放时很常见)只查一次页表，整段挂回
+    while (start)
     {
-        void* next = NextObj(cur);
-        Span* span = PageCache::GetInstance()->MapObjToSpan(cur);
-
-        if (groupStart.find(span) == groupStart.end())
-        {
-            groupStart[span] = cur;
-            groupEnd[span] = cur;
-            groupCount[span] = 1;
-        }
-        else
+        Span* span = _pageCache->MapObjToSpan(start);
+        char* spanBegin = (char*)(span->_pageId << PAGE_SHIFT);
+        char* spanEnd = spanBegin + (span->_n << PAGE_SHIFT);
+
+        void* tail = start;
+        size_t n = 1;
+        void* next = NextObj(tail);
+        while (next && (char*)next >= spanBegin && (char*)next < spanEnd)
         {
-            NextObj(groupEnd[span]) = cur;
-            groupEnd[span] = cur;
-            groupCount[span] += 1;
+            tail = next;
+            next = NextObj(tail);
+            ++n;
         }
-        cur = next;
-    }
-    // 断尾
-    for (auto& kv : groupEnd)
-    {
-        NextObj(kv.second) = nullptr;
-    }
-    PageCache::GetInstance()->Getmtx().unlock();
-
-    // 2) 在中心缓存桶锁下，批量把各组挂回span，并处理useCount==0的回收
-    _spanList[index]._mtx.lock();
-
-    for (auto& kv : groupStart)
-    {
-        Span* span = kv.first;
-        void* gstart = kv.second;
-        void* gend = groupEnd[span];
-        size_t cnt = groupCount[span];
 
-        NextObj(gend) = span->_freeList;
-        span->_freeList = gstart;
-        span->_useCount -= cnt;
+        NextObj(tail) = span->_freeList;
+        span->_freeList = start;
+        span->_useCount -= n;
 
         if (span->_useCount == 0)
         {
@@ -144,12 +112,12 @@ void CentralCache::ReleaseListToSpans(void* start, size_t size)
 
             _spanList[index]._mtx.unlock();
 
-            PageCache::GetInstance()->Getmtx().lock();
-            PageCache::GetInstance()->ReleaseSpanToPageCache(span);
-            PageCache::GetInstance()->Getmtx().unlock();
+            _pageCache->ReleaseSmallSpan(span);
 
             _spanList[index]._mtx.lock();
         }
+
+        start = next;
     }
 
     _spanList[index]._mtx.unlock();
@@ -4,9 +4,7 @@
 
 class CentralCache {
 public:
-    static CentralCache* GetInstance() {
-        return &_sInst;
-    }
+    static CentralCache* GetInstance();
     //获取一个非空span
     Span* GetOneSpan(SpanList& list,size_t byte_size);
 
@@ -19,11 +17,19 @@ public:
 
 private:
     SpanList _spanList[NFREELIST];
+    PageCache* _pageCache;  // 切分span的来源：默认是全局页缓存，Heap 实例用自己的
 private:
+    friend class Heap;
+    friend class NumaPartitions;
     CentralCache(const CentralCache&) = delete;
-    CentralCache(){}
-
-    static CentralCache _sInst;
+    explicit CentralCache(PageCache* pageCache) : _pageCache(pageCache) {}
 };
 
+// 同 PageCache::GetInstance，首次使用时构造且永不析构
+inline CentralCache* CentralCache::GetInstance() {
+    alignas(CentralCache) static char storage[sizeof(CentralCache)];
+    static CentralCache* inst = new (storage) CentralCache(PageCache::GetInstance());
+    return inst;
+}
+
 
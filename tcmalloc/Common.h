@@ -20,16 +20,180 @@ typedef size_t PAGE_ID;
 // linux
 typedef unsigned long long  PAGE_ID;
 #include<sys/mman.h>
+#include<sys/syscall.h>
 #include<unistd.h>
 #include <errno.h>
 #include<cstring>
+#if defined(__has_include)
+#if __has_include(<linux/mempolicy.h>)
+#include<linux/mempolicy.h>
+#define SYSTEM_HAVE_MEMPOLICY 1
+#endif
+#endif
+#endif
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#endif
+
+// 线程缓存指针的TLS模型：编进动态库时默认是 global-dynamic，每次访问都要调 __tls_get_addr；
+// libconcurrentalloc.so 随 LD_PRELOAD 在程序启动时装入，静态TLS块里有它的位置，
+// 用 initial-exec 按固定偏移直接访问(不支持 dlopen 装入本库)
+#if defined(__GNUC__) && !defined(_WIN32)
+#define TLS_INITIAL_EXEC __attribute__((tls_model("initial-exec")))
+#else
+#define TLS_INITIAL_EXEC
 #endif
 
 static const size_t MAX_BYTES = 256 * 1024;
-static const size_t NFREELIST = 208;
 static const size_t NPAGES = 129;
 static const size_t PAGE_SHIFT = 12;
 
+// 透明大页(THP)：2MB，TCMALLOC_HUGEPAGE=1 时页缓存按大页向系统要内存
+static const size_t HUGE_PAGE_SHIFT = 21;
+static const size_t HUGE_PAGE_PAGES = (size_t)1 << (HUGE_PAGE_SHIFT - PAGE_SHIFT);
+
+// 尺寸类别(自由链表桶)在编译期按以下规则生成，各层只查生成的表：
+//  1. 对象大小：8字节之后 <128字节按16字节递增；>=128字节按 2^floor(log2(size))/8 递增(最多一页)，
+//     内碎片不超过 12.5%；16字节及以上的类别都是16的倍数，对象至少16字节对齐
+//  2. 一批对象数(thread cache与central cache之间一次移动的上限)：MAX_BYTES/size，限制在[2,512]
+//  3. span页数：至少 MIN_SPAN_PAGES 页，能装下一整批对象，且切分后尾部浪费不超过 1/8
+//  4. 与上一类别的span页数、每span对象数都相同时，直接并入上一类别(类别更少，碎片不增加)
+// 编译时定义 SIZE_CLASS_FILE 则改用该头文件里的 CUSTOM_SIZE_CLASSES(由 SizeClassTool
+// 根据实际的申请直方图生成)，批量与页数仍按规则2、3计算
+static const size_t MAX_SIZE_CLASSES = 256;
+static const size_t MIN_SPAN_PAGES = 4;
+
+// 大小->桶号查表的粒度：SMALL_CLASS_LIMIT以内每8字节一格，以上每128字节一格，
+// 类别大小必须是对应粒度的倍数(16字节及以上还必须是16的倍数)
+static const size_t SMALL_CLASS_LIMIT = 8 * 1024;
+
+#ifdef SIZE_CLASS_FILE
+#include SIZE_CLASS_FILE
+#endif
+
+struct SizeClassInfo
+{
+	size_t _size;      // 对象大小
+	size_t _pages;     // 切分用span的页数
+	size_t _numToMove; // 一批对象数
+};
+
+struct SizeClassList
+{
+	SizeClassInfo _classes[MAX_SIZE_CLASSES];
+	size_t _count;
+};
+
+static const size_t MIN_ALIGN = 16;
+
+constexpr size_t SizeClassAlignment(size_t size)
+{
+	if (size < MIN_ALIGN)
+		return 8;
+	if (size < 128)
+		return MIN_ALIGN;
+
+	size_t lg = 0;
+	while (((size_t)2 << lg) <= size)
+		++lg;
+	size_t align = ((size_t)1 << lg) / 8;
+	return align > ((size_t)1 << PAGE_SHIFT) ? ((size_t)1 << PAGE_SHIFT) : align;
+}
+
+constexpr size_t SizeClassNumMove(size_t size)
+{
+	size_t num = MAX_BYTES / size;
+	return num < 2 ? 2 : num > 512 ? 512 : num;
+}
+
+constexpr size_t SizeClassPages(size_t size)
+{
+	const size_t page = (size_t)1 << PAGE_SHIFT;
+	size_t psize = MIN_SPAN_PAGES * page;
+	while (psize / size < SizeClassNumMove(size) || psize % size > psize / 8)
+		psize += page;
+	return psize >> PAGE_SHIFT;
+}
+
+constexpr SizeClassList GenerateDefaultSizeClasses()
+{
+	SizeClassList list{};
+	for (size_t size = 8; size <= MAX_BYTES; size += SizeClassAlignment(size))
+	{
+		size_t pages = SizeClassPages(size);
+		if (list._count > 0)
+		{
+			SizeClassInfo& prev = list._classes[list._count - 1];
+			if (prev._pages == pages
+				&& (pages << PAGE_SHIFT) / size == (prev._pages << PAGE_SHIFT) / prev._size)
+			{
+				prev._size = size;
+				prev._numToMove = SizeClassNumMove(size);
+				continue;
+			}
+		}
+		list._classes[list._count++] = SizeClassInfo{ size, pages, SizeClassNumMove(size) };
+	}
+	return list;
+}
+
+constexpr SizeClassList GenerateSizeClasses()
+{
+#ifdef SIZE_CLASS_FILE
+	SizeClassList list{};
+	for (size_t size : CUSTOM_SIZE_CLASSES)
+		list._classes[list._count++] = SizeClassInfo{ size, SizeClassPages(size), SizeClassNumMove(size) };
+	return list;
+#else
+	return GenerateDefaultSizeClasses();
+#endif
+}
+
+// 类别必须递增、满足查表粒度，且最后一个正好是 MAX_BYTES
+constexpr bool SizeClassesValid(const SizeClassList& list)
+{
+	if (list._count == 0 || list._count > 255 || list._classes[list._count - 1]._size != MAX_BYTES)
+		return false;
+	for (size_t i = 0; i < list._count; ++i)
+	{
+		size_t size = list._classes[i]._size;
+		if (size % 8 != 0 || (size >= MIN_ALIGN && size % MIN_ALIGN != 0)
+			|| (size > SMALL_CLASS_LIMIT && size % 128 != 0))
+			return false;
+		if (i > 0 && size <= list._classes[i - 1]._size)
+			return false;
+		if (list._classes[i]._pages > NPAGES - 1)
+			return false;
+	}
+	return true;
+}
+
+static_assert(SizeClassesValid(GenerateSizeClasses()), "invalid size class table");
+
+static const size_t NFREELIST = GenerateSizeClasses()._count;
+
+// 所有线程缓存合计可持有的字节数（环境变量 TCMALLOC_THREAD_CACHE_BYTES 可覆盖）
+static const size_t THREAD_CACHE_BUDGET = 32 * 1024 * 1024;
+// 单个线程缓存的上限范围，以及一次从别的线程缓存偷取的额度
+static const size_t MIN_THREAD_CACHE = 2 * MAX_BYTES;
+static const size_t MAX_THREAD_CACHE = 4 * 1024 * 1024;
+static const size_t THREAD_CACHE_STEAL = 64 * 1024;
+// 线程缓存每释放这么多次，按低水位回收一次闲置对象
+static const size_t SCAVENGE_INTERVAL = 16 * 1024;
+
+
+// 最低的置位位号，x 不能为0
+inline static size_t FindFirstSet(uint64_t x)
+{
+	assert(x != 0);
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return index;
+#else
+	return (size_t)__builtin_ctzll(x);
+#endif
+}
 
 // 直接去堆上按页申请空间
 inline static void* SystemAlloc(size_t kpage)
@@ -64,6 +228,154 @@ inline static void SystemFree(void* ptr, size_t kpage)
 #endif
 }
 
+// 预留 kpage 页的虚拟地址，起点按2MB对齐：不可访问、不占提交额度，之后用 SystemCommit 分段提交；
+// 地址空间受限等原因预留失败时返回nullptr
+inline static void* SystemReserve(size_t kpage)
+{
+#ifdef _WIN32
+	return VirtualAlloc(0, kpage << PAGE_SHIFT, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	const size_t bytes = (kpage + HUGE_PAGE_PAGES) << PAGE_SHIFT;
+	char* ptr = (char*)mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+	if (ptr == MAP_FAILED)
+		return nullptr;
+	const uintptr_t mask = ((uintptr_t)1 << HUGE_PAGE_SHIFT) - 1;
+	char* aligned = (char*)(((uintptr_t)ptr + mask) & ~mask);
+	size_t head = (size_t)(aligned - ptr) >> PAGE_SHIFT;
+	if (head > 0)
+		munmap(ptr, head << PAGE_SHIFT);
+	if (head < HUGE_PAGE_PAGES)
+		munmap(aligned + (kpage << PAGE_SHIFT), (HUGE_PAGE_PAGES - head) << PAGE_SHIFT);
+	return aligned;
+#endif
+}
+
+// 提交预留区间里的 kpage 页，之后可以读写；页仍在首次写入时才真正分配
+inline static void SystemCommit(void* ptr, size_t kpage)
+{
+#ifdef _WIN32
+	if (VirtualAlloc(ptr, kpage << PAGE_SHIFT, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+		throw std::bad_alloc();
+#else
+	if (mprotect(ptr, kpage << PAGE_SHIFT, PROT_READ | PROT_WRITE) != 0)
+		throw std::bad_alloc();
+#endif
+}
+
+// 把一段空闲内存还给系统但保留映射：MADV_DONTNEED 立即释放，之后再访问时内核给全0的新页；
+// lazy 时改用 MADV_FREE，内核在内存紧张时才真正回收，内容不保证为0。返回之后是否保证全0
+inline static bool SystemRelease(void* ptr, size_t kpage, bool lazy)
+{
+#ifdef _WIN32
+	VirtualFree(ptr, kpage << PAGE_SHIFT, MEM_DECOMMIT);
+	return true;
+#else
+#ifdef MADV_FREE
+	if (lazy && madvise(ptr, kpage << PAGE_SHIFT, MADV_FREE) == 0)
+		return false;
+#endif
+	madvise(ptr, kpage << PAGE_SHIFT, MADV_DONTNEED);
+	return true;
+#endif
+}
+
+// 重新使用 SystemRelease 过的内存：linux 下映射一直在，访问时内核重新分配页，不需要系统调用；
+// Windows 下 MEM_DECOMMIT 过的要重新提交
+inline static void SystemRecommit(void* ptr, size_t kpage)
+{
+#ifdef _WIN32
+	SystemCommit(ptr, kpage);
+#else
+	(void)ptr;
+	(void)kpage;
+#endif
+}
+
+// 映射 kpage 页(大页的整数倍)，起点按2MB对齐，并建议内核用透明大页：
+// 多映射一个大页，切掉首尾不对齐的部分
+inline static void* SystemAllocHuge(size_t kpage)
+{
+#ifdef _WIN32
+	return SystemAlloc(kpage);
+#else
+	char* ptr = (char*)SystemAlloc(kpage + HUGE_PAGE_PAGES);
+	const uintptr_t mask = ((uintptr_t)1 << HUGE_PAGE_SHIFT) - 1;
+	char* aligned = (char*)(((uintptr_t)ptr + mask) & ~mask);
+	size_t head = (size_t)(aligned - ptr) >> PAGE_SHIFT;
+	if (head > 0)
+		SystemFree(ptr, head);
+	if (head < HUGE_PAGE_PAGES)
+		SystemFree(aligned + (kpage << PAGE_SHIFT), HUGE_PAGE_PAGES - head);
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, kpage << PAGE_SHIFT, MADV_HUGEPAGE);
+#endif
+	return aligned;
+#endif
+}
+
+// 让一段 SystemAlloc 得到的映射优先从NUMA节点 node 上分配物理页(页在首次写入时才真正分配)；
+// 用 MPOL_PREFERRED 而不是 MPOL_BIND：节点内存用完时退到别的节点，而不是触发OOM。
+// 内核不支持或节点不存在时什么都不做，内存照常可用
+inline static void SystemBindNode(void* ptr, size_t kpage, int node)
+{
+#if defined(SYSTEM_HAVE_MEMPOLICY) && defined(SYS_mbind)
+	unsigned long mask[16] = {};
+	const int bits = (int)(sizeof(mask) * 8);
+	if (node < 0 || node >= bits)
+		return;
+	mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+	// maxnode 按内核的约定多传1
+	syscall(SYS_mbind, ptr, kpage << PAGE_SHIFT, MPOL_PREFERRED, mask, (unsigned long)bits + 1, 0);
+#else
+	(void)ptr; (void)kpage; (void)node;
+#endif
+}
+
+// 超过这个大小的清零改用不经过CPU缓存的流式写：远大于缓存的buffer用普通写，
+// 每一行都要先读进缓存再改写，还会把缓存里有用的数据挤出去
+static const size_t NT_CLEAR_THRESHOLD = 8 * 1024 * 1024;
+
+inline static void ClearMemory(void* ptr, size_t bytes)
+{
+#if defined(__SSE2__)
+	if (bytes >= NT_CLEAR_THRESHOLD)
+	{
+		char* p = (char*)ptr;
+		char* end = p + bytes;
+		char* a = (char*)(((uintptr_t)p + 63) & ~(uintptr_t)63);
+		memset(p, 0, a - p);
+
+		const __m128i zero = _mm_setzero_si128();
+		for (; a + 64 <= end; a += 64)
+		{
+			_mm_stream_si128((__m128i*)a, zero);
+			_mm_stream_si128((__m128i*)(a + 16), zero);
+			_mm_stream_si128((__m128i*)(a + 32), zero);
+			_mm_stream_si128((__m128i*)(a + 48), zero);
+		}
+		_mm_sfence();
+		memset(a, 0, end - a);
+		return;
+	}
+#endif
+	memset(ptr, 0, bytes);
+}
+
+// 调整一段 SystemAlloc 得到的映射的大小，linux下由内核搬页表而不复制数据，可能返回新地址；
+// 范围跨了几个映射等情况下失败返回nullptr
+inline static void* SystemRemap(void* ptr, size_t oldPages, size_t newPages)
+{
+#ifdef _WIN32
+	void* nptr = SystemAlloc(newPages);
+	memcpy(nptr, ptr, (oldPages < newPages ? oldPages : newPages) << PAGE_SHIFT);
+	SystemFree(ptr, oldPages);
+	return nptr;
+#else
+	void* nptr = mremap(ptr, oldPages << PAGE_SHIFT, newPages << PAGE_SHIFT, MREMAP_MAYMOVE);
+	return nptr == MAP_FAILED ? nullptr : nptr;
+#endif
+}
+
 static void*& NextObj(void* obj)
 {
 	return *(void**)obj;
@@ -102,6 +414,8 @@ public:
         _freeList = NextObj(end);
         NextObj(end) = nullptr;
         _size -= n;
+        if (_size < _lowWater)
+            _lowWater = _size;
     }
 
     void* Pop()
@@ -112,6 +426,8 @@ public:
         void* obj = _freeList;
         _freeList = NextObj(obj);
         --_size;
+        if (_size < _lowWater)
+            _lowWater = _size;
 
         return obj;
     }
@@ -121,6 +437,11 @@ public:
         return _freeList == nullptr;
     }
 
+    void* Front()
+    {
+        return _freeList;
+    }
+
     size_t& MaxSize()
     {
         return _maxSize;
@@ -135,49 +456,92 @@ public:
         return _size;
     }
 
+    // 上次重置以来链表长度的最小值：这么多对象在整个区间内都没被用到
+    size_t LowWater()
+    {
+        return _lowWater;
+    }
+
+    void ResetLowWater()
+    {
+        _lowWater = _size;
+    }
+
 private:
     void* _freeList = nullptr;
     size_t _maxSize = 32;
     size_t _size = 0; //当前链表下挂的对象个数
+    size_t _lowWater = 0;
+};
+
+// 大小->桶号的查表索引：[0,SMALL_CLASS_LIMIT] 按8字节一格，(SMALL_CLASS_LIMIT,MAX_BYTES] 按128字节一格
+static const size_t CLASS_ARRAY_OFFSET = ((SMALL_CLASS_LIMIT >> 3) << 7) - SMALL_CLASS_LIMIT;
+static const size_t CLASS_ARRAY_SIZE = ((MAX_BYTES + 127 + CLASS_ARRAY_OFFSET) >> 7) + 1;
+
+// 编译期生成的映射表
+struct SizeClassTable
+{
+	unsigned char _classArray[CLASS_ARRAY_SIZE]; // 查表索引 -> 桶号
+	size_t _classToSize[NFREELIST];              // 桶号 -> 对象大小
+	size_t _classToPages[NFREELIST];             // 桶号 -> span页数
+	size_t _numToMove[NFREELIST];                // 桶号 -> 一批对象数
 };
 
 // 计算对象大小的对齐映射规则
 class SizeClass
 {
 public:
-	// 整体控制在最多10%左右的内碎片浪费
-	// [1,128]					8byte对齐	    freelist[0,16)
-	// [128+1,1024]				16byte对齐	    freelist[16,72)
-	// [1024+1,8*1024]			128byte对齐	    freelist[72,128)
-	// [8*1024+1,64*1024]		1024byte对齐     freelist[128,184)
-	// [64*1024+1,256*1024]		8*1024byte对齐   freelist[184,208)
+	// 类别的生成规则见 GenerateSizeClasses，运行时大小->桶号->对象大小/批量/页数都是查表
 
 	static inline size_t _RoundUp(size_t bytes, size_t alignNum)
 	{
 		return ((bytes + alignNum - 1) & ~(alignNum - 1));
 	}
 
-	static inline size_t RoundUp(size_t size)
+	// 查表索引：SMALL_CLASS_LIMIT以内类别大小都是8的倍数，以上都是128的倍数，
+	// 同一格里的大小必然落在同一个桶
+	static constexpr size_t ClassArrayIndex(size_t bytes)
 	{
-		if (size <= 128)
-		{
-			return _RoundUp(size, 8);
-		}
-		else if (size <= 1024)
-		{
-			return _RoundUp(size, 16);
-		}
-		else if (size <= 8*1024)
+		return bytes <= SMALL_CLASS_LIMIT
+			? (bytes + 7) >> 3
+			: (bytes + 127 + CLASS_ARRAY_OFFSET) >> 7;
+	}
+
+	static constexpr SizeClassTable MakeTable()
+	{
+		SizeClassTable t{};
+
+		SizeClassList list = GenerateSizeClasses();
+		for (size_t i = 0; i < NFREELIST; ++i)
 		{
-			return _RoundUp(size, 128);
+			t._classToSize[i] = list._classes[i]._size;
+			t._classToPages[i] = list._classes[i]._pages;
+			t._numToMove[i] = list._classes[i]._numToMove;
 		}
-		else if (size <= 64*1024)
+
+		// 每个查表格取该格最大的大小所属的桶
+		size_t cl = 0;
+		for (size_t i = 0; i < CLASS_ARRAY_SIZE; ++i)
 		{
-			return _RoundUp(size, 1024);
+			size_t maxBytes = i <= (SMALL_CLASS_LIMIT >> 3) ? (i << 3) : (i << 7) - CLASS_ARRAY_OFFSET;
+			while (cl + 1 < NFREELIST && t._classToSize[cl] < maxBytes)
+				++cl;
+			t._classArray[i] = (unsigned char)cl;
 		}
-		else if (size <= 256 * 1024)
+		return t;
+	}
+
+	static inline const SizeClassTable& Table()
+	{
+		static constexpr SizeClassTable table = MakeTable();
+		return table;
+	}
+
+	static inline size_t RoundUp(size_t size)
+	{
+		if (size <= MAX_BYTES)
 		{
-			return _RoundUp(size, 8*1024);
+			return ClassSize(Index(size));
 		}
 		else
 		{
@@ -186,72 +550,51 @@ public:
 		}
 	}
 
-	static inline size_t _Index(size_t bytes, size_t align_shift)
-	{
-		return ((bytes + (1 << align_shift) - 1) >> align_shift) - 1;
-	}
-
 	// 计算映射的哪一个自由链表桶
 	static inline size_t Index(size_t bytes)
 	{
 		assert(bytes <= MAX_BYTES);
 
-		// 每个区间有多少个链
-		static int group_array[4] = { 16, 56, 56, 56 };
-		if (bytes <= 128){
-			return _Index(bytes, 3);
-		}
-		else if (bytes <= 1024){
-			return _Index(bytes - 128, 4) + group_array[0];
-		}
-		else if (bytes <= 8 * 1024){
-			return _Index(bytes - 1024, 7) + group_array[1] + group_array[0];
-		}
-		else if (bytes <= 64 * 1024){
-			return _Index(bytes - 8 * 1024, 10) + group_array[2] + group_array[1] + group_array[0];
-		}
-		else if (bytes <= 256 * 1024){
-			return _Index(bytes - 64 * 1024, 13) + group_array[3] + group_array[2] + group_array[1] + group_array[0];
-		}
-		else{
-			assert(false);
-		}
-
-		return -1;
+		return Table()._classArray[ClassArrayIndex(bytes)];
 	}
 
-	// 一次thread cache从中心缓存获取多少个
-	static size_t NumMoveSize(size_t size)
+	// Index 的逆映射：自由链表桶号对应的对象大小
+	static inline size_t ClassSize(size_t index)
 	{
-		assert(size > 0);
+		assert(index < NFREELIST);
 
-		// [2, 512]，一次批量移动多少个对象的(慢启动)上限值
-		// 小对象一次批量上限高
-		// 小对象一次批量上限低
-		int num = MAX_BYTES / size;
-		if (num < 2)
-			num = 2;
-
-		if (num > 512)
-			num = 512;
+		return Table()._classToSize[index];
+	}
 
-		return num;
+	// 一次thread cache从中心缓存获取多少个(慢启动的上限)
+	static inline size_t NumMoveSize(size_t size)
+	{
+		assert(size > 0);
+		return Table()._numToMove[Index(size)];
 	}
 
-	// 计算一次向系统获取几个页
-	// 单个对象 8byte
-	// ...
-	// 单个对象 256KB
-	static size_t NumMovePage(size_t size)
+	// 中心缓存向page cache申请span时一次要几页
+	static inline size_t NumMovePage(size_t size)
 	{
-		size_t num = NumMoveSize(size);
-		size_t npage = num*size;
+		return Table()._classToPages[Index(size)];
+	}
 
-		npage >>= PAGE_SHIFT;
-		if (npage == 0)
-			npage = 1;
+	// 切分该类别的span需要按几页对齐：超过一页的2的幂类别按类别大小对齐，
+	// 这样切出来的每个对象都天然按自身大小对齐
+	static inline size_t SpanAlignPages(size_t size)
+	{
+		return (size & (size - 1)) == 0 && size > ((size_t)1 << PAGE_SHIFT) ? size >> PAGE_SHIFT : 1;
+	}
 
-		return npage;
+	// 该类别对象天然具有的对齐：对象从span起点按类别大小依次排开，
+	// 2的幂类别按自身大小对齐，其他类别取类别大小的最低位，最多一页
+	static inline size_t ClassAlignment(size_t index)
+	{
+		size_t size = ClassSize(index);
+		size_t low = size & (~size + 1);
+		if (low == size)
+			return size;
+		return low < ((size_t)1 << PAGE_SHIFT) ? low : ((size_t)1 << PAGE_SHIFT);
 	}
 };
 
@@ -264,24 +607,34 @@ struct Span
 	Span* _next = nullptr;	// 双向链表的结构
 	Span* _prev = nullptr;
 
-	size_t _objSize = 0;  // 切好的小对象的大小
+	size_t _objSize = 0;  // 切好的小对象的大小；页级span为申请的字节数
 	size_t _useCount = 0; // 切好小块内存，被分配给thread cache的计数
 	void* _freeList = nullptr;  // 切好的小块内存的自由链表
 
 	bool _isUse = false;          // 是否在被使用
+	bool _isPageSpan = false;     // 整个span直接交给一次申请(大对象或大对齐)，没有切成小对象
+	bool _isZero = false;         // 空闲时：自mmap以来没被写过，内容全0；在用时：交出去那一刻是否全0
+	unsigned char _lane = 0;      // 所属的页缓存分组(PageCache::LaneOf)，空闲时挂在本组的链表上
+	bool _isReleased = false;     // 空闲且物理页已还给系统(PageCache::ReleaseFreePages)
+	bool _isLarge = false;        // 取自单独向系统要的超大内存，空闲时在超大span缓存里，不进空闲链表
 };
 
 // 带头双向循环链表
 class SpanList
 {
 public:
+	// 哨兵头结点内嵌在链表中，不走 new：全局 operator new 被替换后，
+	// 构造 CentralCache/PageCache 时不能反过来依赖它们自己
 	SpanList()
 	{
-		_head = new Span;
+		_head = &_sentinel;
 		_head->_next = _head;
 		_head->_prev = _head;
 	}
 
+	SpanList(const SpanList&) = delete;
+	SpanList& operator=(const SpanList&) = delete;
+
 	Span* Begin()
 	{
 		return _head->_next;
@@ -336,6 +689,7 @@ public:
 	}
 
 private:
+	Span _sentinel;
 	Span* _head;
 public:
 	std::mutex _mtx; // 桶锁
@@ -1,61 +1,477 @@
 #pragma  once
 
 #include"ThreadCache.h"
+#include"CpuCache.h"
+#include"Scavenger.h"
+#include"AllocHistogram.h"
 #include"PageCache.h"
+#include"Heap.h"
+#include"Numa.h"
+#include"Region.h"
 #include"ObjectPool.h"
 #include"Common.h"
+#include<cstdio>
+#include<cstdlib>
+#include<cstdint>
 
 
+// 取得当前线程的ThreadCache，首次使用时创建
+// 释放路径也要走这里：对象可能在从未申请过内存的线程里被释放
+static inline ThreadCache* GetThreadCache() {
+    if(TlsThreadCache == nullptr)
+        TlsThreadCache = ThreadCache::Create();
+    return TlsThreadCache;
+}
+
+// 小对象前端：编译时定义 PERCPU_CACHE 则优先使用每CPU缓存，
+// 当前线程拿不到CPU号(rseq不可用)时退回ThreadCache
+static inline void* FrontAllocate(size_t size) {
+#ifdef PERCPU_CACHE
+    if (CpuCache* cc = CpuCache::Current())
+        return cc->Allocate(size);
+#endif
+    return GetThreadCache()->Allocate(size);
+}
+
+static inline void FrontDeallocate(void* ptr, size_t size) {
+#ifdef PERCPU_CACHE
+    if (CpuCache* cc = CpuCache::Current())
+    {
+        cc->Deallocate(ptr, size);
+        return;
+    }
+#endif
+    GetThreadCache()->Deallocate(ptr, size);
+}
+
+static inline void FrontAllocateBatch(size_t size, size_t n, void** out) {
+#ifdef PERCPU_CACHE
+    if (CpuCache* cc = CpuCache::Current())
+    {
+        cc->AllocateBatch(size, n, out);
+        return;
+    }
+#endif
+    GetThreadCache()->AllocateBatch(size, n, out);
+}
+
+static inline void FrontDeallocateRange(size_t index, void* start, size_t n) {
+#ifdef PERCPU_CACHE
+    if (CpuCache* cc = CpuCache::Current())
+    {
+        cc->DeallocateRange(index, start, n);
+        return;
+    }
+#endif
+    GetThreadCache()->DeallocateRange(index, start, n);
+}
+
+// NUMA 模式下释放小对象：属于前端缓存所在分区的照常挂回，
+// 别的分区的直接还给它所属的中心缓存，不让本节点的线程再拿去用
+static inline void NumaDeallocate(void* ptr, size_t size, size_t node) {
+    CentralCache* owner = NumaPartitions::GetCentralCache(node);
+#ifdef PERCPU_CACHE
+    if (CpuCache* cc = CpuCache::Current())
+    {
+        if (cc->GetCentralCache() == owner)
+        {
+            cc->Deallocate(ptr, size);
+            return;
+        }
+    }
+    else
+#endif
+    {
+        ThreadCache* tc = GetThreadCache();
+        if (tc->GetCentralCache() == owner)
+        {
+            tc->Deallocate(ptr, size);
+            return;
+        }
+    }
+    NextObj(ptr) = nullptr;
+    owner->ReleaseListToSpans(ptr, size);
+}
+
+// 大对象直接向PageCache申请整页span；zeroed非空时带回这段内存是否保证全0(mmap以来没被写过)
+// 超过 NPAGES-1 页的大块先从超大span缓存取，缓存里没有再在锁外 mmap：失败时抛出的 bad_alloc
+// 本身要申请内存，持着页缓存锁抛出会在分配异常对象时死锁(malloc 被替换后尤其如此)
+static inline void* LargeAlloc(PageCache* pc, size_t size, bool* zeroed = nullptr) {
+
+    // 按页取整会溢出的大小不可能满足
+    if(size > (size_t)PTRDIFF_MAX)
+        throw std::bad_alloc();
+
+    size_t alignsize = SizeClass::RoundUp(size);
+    size_t kpage = alignsize >> PAGE_SHIFT;
+
+    std::unique_lock<std::mutex> ul(pc->Getmtx());
+    Span* span = kpage > NPAGES - 1 ? pc->TakeLargeSpan(kpage) : pc->NewSpan(kpage);
+    if(span == nullptr)
+    {
+        ul.unlock();
+        void* mem = pc->AllocPages(kpage);
+        ul.lock();
+        span = pc->NewHugeSpan(mem, kpage);
+    }
+    span->_objSize = size;
+    span->_isUse = true;
+    pc->MarkPageSpan(span);
+    if(zeroed)
+        *zeroed = span->_isZero;
+
+    return (void*)(span->_pageId << PAGE_SHIFT);
+}
+
 static void* ConcurrentAlloc(size_t size) {
 
+#ifdef ALLOC_HISTOGRAM
+    RecordAllocSize(size);
+#endif
+
     if(size > MAX_BYTES)
     {
-        size_t alignsize = SizeClass::RoundUp(size);
-        size_t kpage = alignsize >> PAGE_SHIFT;
+        return LargeAlloc(NumaPartitions::GetPageCache(NumaPartitions::CurrentNode()), size);
+    }
+    else
+    {
+        return FrontAllocate(size);
+    }
+}
 
-        //直接向PageCache申请
 
-        PageCache::GetInstance()->Getmtx().lock();
-        Span* span = PageCache::GetInstance()->NewSpan(kpage);
-        span->_objSize = size;
-        span->_isUse = true;
-        PageCache::GetInstance()->Getmtx().unlock();
+static void ConcurrentFree(void* ptr) {
+
+    // 页号->span 的映射是原子读，释放路径查找不需要加 PageCache 锁
+    size_t node;
+    Span* span = NumaPartitions::MapObjToSpan(ptr, node);
 
+    if(span->_isPageSpan)
+    {
+        PageCache* pc = NumaPartitions::GetPageCache(node);
+        pc->Getmtx().lock();
+        pc->ReleaseSpanToPageCache(span);
+        pc->Getmtx().unlock();
+    }
+    else if(NumaPartitions::Count() > 1)
+    {
+        NumaDeallocate(ptr, span->_objSize, node);
+    }
+    else
+    {
+        FrontDeallocate(ptr,span->_objSize);
+    }
+}
 
-        void* ptr = (void*)(span->_pageId << PAGE_SHIFT);
+// 带大小的释放：调用者给出申请时的大小，直接按SizeClass::Index
+// 挂回前端缓存自由链表，快路径不查页表、不碰Span所在缓存行
+// 编译时定义 CHECK_SIZED_FREE 可开启调试检查，核对调用者的大小与span记录的_objSize
+// NUMA 模式下要查对象属于哪个分区，退回不带大小的释放
+static inline void ConcurrentFree(void* ptr, size_t size) {
 
-        return ptr;
+    if(size > MAX_BYTES || NumaPartitions::Count() > 1)
+    {
+        ConcurrentFree(ptr);
+        return;
+    }
+
+#ifdef CHECK_SIZED_FREE
+    Span* span = PageCache::GetInstance()->MapObjToSpan(ptr);
+    if(span == nullptr || span->_objSize != SizeClass::RoundUp(size))
+    {
+        fprintf(stderr, "ConcurrentFree(%p, %zu): size mismatch, span objSize %zu\n",
+            ptr, size, span ? span->_objSize : (size_t)0);
+        abort();
+    }
+#endif
+
+    FrontDeallocate(ptr,size);
+}
+
+// 从指定的堆申请：小对象走当前线程在这个堆上的线程缓存，大对象向这个堆的页缓存要
+static inline void* ConcurrentAlloc(Heap* heap, size_t size) {
+
+#ifdef ALLOC_HISTOGRAM
+    RecordAllocSize(size);
+#endif
+
+    if(size > MAX_BYTES)
+        return LargeAlloc(heap->GetPageCache(), size);
+    return heap->LocalCache()->Allocate(size);
+}
+
+// 还给申请它的堆；不用逐个释放也可以，Destroy 时整体回收
+static inline void ConcurrentFree(Heap* heap, void* ptr) {
+
+    PageCache* pc = heap->GetPageCache();
+    Span* span = pc->MapObjToSpan(ptr);
+    if(span->_isPageSpan)
+    {
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        pc->ReleaseSpanToPageCache(span);
     }
     else
     {
-        if(TlsThreadCache == nullptr)
+        heap->LocalCache()->Deallocate(ptr, span->_objSize);
+    }
+}
+
+// ptr实际可用的字节数，对应 malloc_usable_size，ptr为空时返回0
+// 小对象span记录的是类别大小；页级span记录的是申请的大小，可用的是整个span的页
+static inline size_t ConcurrentUsableSize(void* ptr) {
+
+    if(ptr == nullptr)
+        return 0;
+
+    size_t node;
+    Span* span = NumaPartitions::MapObjToSpan(ptr, node);
+    if(span->_isPageSpan)
+        return span->_n << PAGE_SHIFT;
+    return span->_objSize;
+}
+
+// 申请结果：指针和实际可用的字节数
+struct SizedPtr
+{
+    void* _ptr;
+    size_t _size;
+};
+
+// 申请至少size字节，同时返回实际可用的大小(小对象为所在类别的大小，大对象是整个span的页，
+// 透明大页模式下取整到整大页)，调用者可以直接用满整个类别，容器按它定容量能少扩容几次
+// 释放用 ConcurrentFree(ptr) 或 ConcurrentFree(ptr, 返回的_size)
+static inline SizedPtr ConcurrentAllocAtLeast(size_t size) {
+
+    void* ptr = ConcurrentAlloc(size);
+    if(size > MAX_BYTES)
+        return SizedPtr{ ptr, ConcurrentUsableSize(ptr) };
+    return SizedPtr{ ptr, SizeClass::RoundUp(size) };
+}
+
+// 批量申请：n个size字节的对象写入out，整段从自由链表/中心缓存取，省去逐个调用的开销
+static inline void ConcurrentAllocBatch(size_t size, size_t n, void** out) {
+
+    if(size > MAX_BYTES)
+    {
+        for(size_t i = 0; i < n; ++i)
+            out[i] = ConcurrentAlloc(size);
+        return;
+    }
+
+#ifdef ALLOC_HISTOGRAM
+    RecordAllocSize(size, n);
+#endif
+
+    FrontAllocateBatch(size, n, out);
+}
+
+// 批量释放：大小可以各不相同，先按尺寸类别串成链表，攒够一批就整段交给前端缓存，
+// 多出的部分在中心缓存里按span整段挂回。分批交出是为了链表还在CPU缓存里时就处理掉，
+// 一次串完几百MB的对象再回头遍历，会全部变成缓存未命中
+static inline void ConcurrentFreeBatch(void** ptrs, size_t n) {
+
+    // NUMA 模式下同一批里可能混着各分区的对象，逐个按所属分区释放
+    if(NumaPartitions::Count() > 1)
+    {
+        for(size_t i = 0; i < n; ++i)
+            ConcurrentFree(ptrs[i]);
+        return;
+    }
+
+    // 保持原来的顺序串到各类别链表尾部，同一个span的对象仍然连成一段
+    void* heads[NFREELIST] = {};
+    void* tails[NFREELIST];
+    size_t counts[NFREELIST] = {};
+    for(size_t i = 0; i < n; ++i)
+    {
+        Span* span = PageCache::GetInstance()->MapObjToSpan(ptrs[i]);
+        if(span->_isPageSpan)
+        {
+            ConcurrentFree(ptrs[i]);
+            continue;
+        }
+
+        size_t index = SizeClass::Index(span->_objSize);
+        if(counts[index]++ == 0)
+            heads[index] = ptrs[i];
+        else
+            NextObj(tails[index]) = ptrs[i];
+        tails[index] = ptrs[i];
+
+        if(counts[index] == SizeClass::NumMoveSize(span->_objSize))
+        {
+            NextObj(tails[index]) = nullptr;
+            FrontDeallocateRange(index, heads[index], counts[index]);
+            counts[index] = 0;
+        }
+    }
+
+    for(size_t index = 0; index < NFREELIST; ++index)
+    {
+        if(counts[index] > 0)
         {
-            static ObjectPool<ThreadCache> tcpool;
-            static std::mutex m;
-            std::lock_guard<std::mutex> lg(m);
-            if (TlsThreadCache == nullptr)
-                TlsThreadCache = tcpool.New();
+            NextObj(tails[index]) = nullptr;
+            FrontDeallocateRange(index, heads[index], counts[index]);
         }
-        
-        return TlsThreadCache->Allocate(size);
     }
 }
 
+// 按alignment(2的幂)对齐申请size字节，alignment不是2的幂时返回nullptr
+// 1. 小对象：从 size 对应的类别往上找第一个天然满足对齐的类别(16字节以内所有类别都满足，
+//    2的幂类别按自身大小对齐)，走普通的前端缓存
+// 2. 找不到(对齐超过一页或对象太大)：向PageCache要一个起始地址按对齐切好的页级span
+// 释放用 ConcurrentFree(ptr)；带大小的释放不适用，小对象可能落在比 size 更大的类别里
+static inline void* ConcurrentAlignedAlloc(size_t alignment, size_t size) {
 
-static void ConcurrentFree(void* ptr) {
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return nullptr;
 
-    PageCache::GetInstance()->Getmtx().lock();
-    Span* span = PageCache::GetInstance()->MapObjToSpan(ptr);
-    PageCache::GetInstance()->Getmtx().unlock();
+    size_t need = size < alignment ? alignment : size;
+    if(need <= MAX_BYTES)
+    {
+        for(size_t index = SizeClass::Index(need); index < NFREELIST; ++index)
+        {
+            if(SizeClass::ClassAlignment(index) >= alignment)
+                return ConcurrentAlloc(SizeClass::ClassSize(index));
+        }
+    }
 
-    if(span->_objSize > MAX_BYTES)
+#ifdef ALLOC_HISTOGRAM
+    RecordAllocSize(size);
+#endif
+
+    if(size > (size_t)PTRDIFF_MAX)
+        throw std::bad_alloc();
+    size_t kpage = SizeClass::_RoundUp(size == 0 ? 1 : size, (size_t)1 << PAGE_SHIFT) >> PAGE_SHIFT;
+    size_t alignPages = alignment >> PAGE_SHIFT;
+    if(alignPages == 0)
+        alignPages = 1;
+
+    // 超大的先从超大span缓存取，没有再在锁外 mmap，原因同 LargeAlloc
+    PageCache* pc = NumaPartitions::GetPageCache(NumaPartitions::CurrentNode());
+    size_t total = pc->AlignedPages(kpage, alignPages);
+    std::unique_lock<std::mutex> ul(pc->Getmtx());
+    Span* span = total > NPAGES - 1 ? pc->TakeAlignedLargeSpan(kpage, alignPages) : pc->NewAlignedSpan(kpage, alignPages);
+    if(span == nullptr)
     {
-        PageCache::GetInstance()->Getmtx().lock();
-        PageCache::GetInstance()->ReleaseSpanToPageCache(span);
-        PageCache::GetInstance()->Getmtx().unlock();
+        ul.unlock();
+        void* mem = pc->AllocPages(total);
+        ul.lock();
+        span = pc->NewAlignedHugeSpan(mem, kpage, alignPages);
     }
-    else
+    span->_objSize = size;
+    span->_isUse = true;
+    pc->MarkPageSpan(span);
+
+    return (void*)(span->_pageId << PAGE_SHIFT);
+}
+
+// 调整ptr指向的内存块到newSize字节，内容保留两者中较小的部分
+// ptr为空等同 ConcurrentAlloc；newSize为0等同 ConcurrentFree 并返回nullptr
+// 1. 小对象：新大小仍在原类别内时原样返回，否则换类别复制，变大到页级span时至少多要1/4
+// 2. 页级span：新大小仍超过 MAX_BYTES 时缩小就地切掉尾页；变大先尝试吞并后面相邻的空闲span；
+//    超过 NPAGES-1 页的大块再试 mremap，不复制数据。缩到 MAX_BYTES 以内的换成小对象复制
+// 返回的内存可以用 ConcurrentFree(ptr, newSize) 带大小释放：小对象总在 newSize 的类别里，页级span总超过 MAX_BYTES
+static inline void* ConcurrentRealloc(void* ptr, size_t newSize) {
+
+    if(ptr == nullptr)
+        return ConcurrentAlloc(newSize);
+    if(newSize == 0)
+    {
+        ConcurrentFree(ptr);
+        return nullptr;
+    }
+
+    if(newSize > (size_t)PTRDIFF_MAX)
+        throw std::bad_alloc();
+
+    // 调用者可能用满了可用大小(ConcurrentAllocAtLeast/ConcurrentUsableSize)，按可用大小保留内容
+    size_t node;
+    Span* span = NumaPartitions::MapObjToSpan(ptr, node);
+    size_t oldSize = span->_isPageSpan ? span->_n << PAGE_SHIFT : span->_objSize;
+
+    if(!span->_isPageSpan)
     {
-        TlsThreadCache->Deallocate(ptr,span->_objSize);
+        if(newSize <= MAX_BYTES && SizeClass::Index(newSize) == SizeClass::Index(oldSize))
+            return ptr;
     }
-}
\ No newline at end of file
+    else if(newSize > MAX_BYTES)
+    {
+        size_t oldPages = span->_n;
+        size_t newPages = SizeClass::_RoundUp(newSize, (size_t)1 << PAGE_SHIFT) >> PAGE_SHIFT;
+        // 对齐申请的页级span起点按对齐切好，原地调整不影响对齐
+        PageCache* pc = NumaPartitions::GetPageCache(node);
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        if(newPages <= oldPages)
+        {
+            pc->ShrinkSpan(span, newPages);
+            span->_objSize = newSize;
+            return ptr;
+        }
+        if(pc->GrowSpanInPlace(span, newPages))
+        {
+            span->_objSize = newSize;
+            return ptr;
+        }
+        if(oldPages > NPAGES - 1 && pc->RemapSpan(span, newPages))
+        {
+            span->_objSize = newSize;
+            return (void*)(span->_pageId << PAGE_SHIFT);
+        }
+    }
+
+    // 需要搬成页级span时，变大至少多要1/4，持续增长的缓冲区不必每次都搬；
+    // 小对象按 newSize 的类别要，带大小释放才找得到类别
+    size_t allocSize = newSize;
+    if(newSize > MAX_BYTES && newSize > oldSize && newSize < oldSize + oldSize / 4)
+        allocSize = oldSize + oldSize / 4;
+
+    void* nptr = ConcurrentAlloc(allocSize);
+    memcpy(nptr, ptr, oldSize < newSize ? oldSize : newSize);
+    ConcurrentFree(ptr);
+    return nptr;
+}
+
+// 申请num个size字节、内容全0的内存，num*size溢出时返回nullptr
+// 大对象拿到的span若自mmap以来没被写过(内核给的匿名页本来就是0)则不再清零；
+// 需要清零的大块用 ClearMemory，超大时走流式写
+static inline void* ConcurrentCalloc(size_t num, size_t size) {
+
+    if(size != 0 && num > (size_t)-1 / size)
+        return nullptr;
+    size_t bytes = num * size;
+
+    if(bytes > MAX_BYTES)
+    {
+#ifdef ALLOC_HISTOGRAM
+        RecordAllocSize(bytes);
+#endif
+        bool zeroed = false;
+        void* ptr = LargeAlloc(NumaPartitions::GetPageCache(NumaPartitions::CurrentNode()), bytes, &zeroed);
+        if(!zeroed)
+            ClearMemory(ptr, bytes);
+        return ptr;
+    }
+
+    // 小对象所在span切分时已经写过链表指针，总要清零
+    void* ptr = ConcurrentAlloc(bytes);
+    memset(ptr, 0, bytes);
+    return ptr;
+}
+
+// 把各分区页缓存里的空闲页全部还给系统(保留映射，再次使用时内核重新分配)，超大span缓存整个 munmap，
+// 返回还了多少字节；中转缓存里的批次先还给中心缓存，空出来的span一并还掉。
+// 线程缓存、中心缓存里的空闲对象不在其内，独立堆(Heap)的页缓存也不在其内
+static inline size_t ConcurrentReleaseFreeMemory() {
+    size_t pages = 0;
+    for (size_t node = 0; node < NumaPartitions::Count(); ++node)
+    {
+        NumaPartitions::GetTransferCache(node)->Drain(NumaPartitions::GetCentralCache(node));
+        PageCache* pc = NumaPartitions::GetPageCache(node);
+        pc->FlushShards();
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        pages += pc->ReleaseLargeCache();
+        pages += pc->ReleaseFreePages((size_t)-1);
+    }
+    return pages << PAGE_SHIFT;
+}
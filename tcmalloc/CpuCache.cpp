@@ -0,0 +1,53 @@
+#include"CpuCache.h"
+#include"ObjectPool.h"
+#include<cstdlib>
+
+std::atomic<CpuCache*> CpuCache::_caches[CpuCache::MAX_CPUS];
+std::atomic<bool> CpuCache::_disabled(false);
+
+//某个CPU第一次被用到时才创建它的缓存
+CpuCache* CpuCache::Create(int cpu)
+{
+    static ObjectPool<CpuCache> ccpool;
+    static std::mutex m;
+    std::lock_guard<std::mutex> lg(m);
+
+    CpuCache* cc = _caches[cpu].load(std::memory_order_relaxed);
+    if (cc != nullptr)
+        return cc;
+
+    const char* env = getenv("TCMALLOC_PERCPU");
+    if (env != nullptr && strcmp(env, "0") == 0)
+    {
+        _disabled.store(true, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    cc = ccpool.New();
+    _caches[cpu].store(cc, std::memory_order_release);
+    return cc;
+}
+
+void CpuCache::ReleaseIdleAll()
+{
+    for (int cpu = 0; cpu < MAX_CPUS; ++cpu)
+    {
+        CpuCache* cc = _caches[cpu].load(std::memory_order_acquire);
+        if (cc == nullptr)
+            continue;
+        std::lock_guard<std::mutex> lg(cc->_mtx);
+        cc->_cache.ReleaseIdle();
+    }
+}
+
+size_t CpuCache::TotalCachedBytes()
+{
+    size_t total = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; ++cpu)
+    {
+        CpuCache* cc = _caches[cpu].load(std::memory_order_acquire);
+        if (cc != nullptr)
+            total += cc->_cache.CachedBytes();
+    }
+    return total;
+}
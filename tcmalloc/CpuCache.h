@@ -0,0 +1,100 @@
+#pragma once
+
+#include"Common.h"
+#include"ThreadCache.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include<sys/rseq.h>
+#define CPUCACHE_HAVE_RSEQ 1
+#endif
+#endif
+
+// 每CPU一份的前端缓存
+// 线程数远多于核数时，每线程一个ThreadCache会让缓存的内存随线程数增长；
+// 按CPU缓存后，缓存总量只随核数增长。
+// 当前CPU号取自glibc注册的rseq区域(cpu_id由内核在调度时更新)，只是一次普通的内存读；
+// 读到CPU号后线程可能被迁移，因此每个CPU缓存仍由一把锁保护，
+// 正常情况下只有运行在该CPU上的线程会去拿这把锁，几乎不存在竞争。
+// 注意这是"每CPU一把锁"的做法，不是tcmalloc那种rseq可重启临界区：
+// 线程在临界区内被抢占或迁移时不会被内核中止重来，正确性完全靠锁保证，
+// rseq只用来挑选(大概率无竞争的)那一份缓存。
+class CpuCache
+{
+public:
+    static const int MAX_CPUS = 1024;
+
+    // 当前CPU的缓存；rseq不可用或被环境变量 TCMALLOC_PERCPU=0 关闭时返回nullptr，
+    // 调用者应退回线程缓存
+    static CpuCache* Current()
+    {
+        if (_disabled.load(std::memory_order_relaxed))
+            return nullptr;
+
+        int cpu = CurrentCpu();
+        if (cpu < 0 || cpu >= MAX_CPUS)
+            return nullptr;
+
+        CpuCache* cc = _caches[cpu].load(std::memory_order_acquire);
+        return cc ? cc : Create(cpu);
+    }
+
+    void* Allocate(size_t size)
+    {
+        std::lock_guard<std::mutex> lg(_mtx);
+        return _cache.Allocate(size);
+    }
+
+    void Deallocate(void* p, size_t size)
+    {
+        std::lock_guard<std::mutex> lg(_mtx);
+        _cache.Deallocate(p, size);
+    }
+
+    void AllocateBatch(size_t size, size_t n, void** out)
+    {
+        std::lock_guard<std::mutex> lg(_mtx);
+        _cache.AllocateBatch(size, n, out);
+    }
+
+    void DeallocateRange(size_t index, void* start, size_t n)
+    {
+        std::lock_guard<std::mutex> lg(_mtx);
+        _cache.DeallocateRange(index, start, n);
+    }
+
+    // 补货/归还的中心缓存：按创建时所在的NUMA分区绑定
+    CentralCache* GetCentralCache() const
+    {
+        return _cache.GetCentralCache();
+    }
+
+    // 对所有已创建的每CPU缓存做一次闲置回收；每CPU缓存有锁，
+    // 可以由后台回收线程代劳，不依赖其上的线程再次运行
+    static void ReleaseIdleAll();
+
+    // 所有每CPU缓存当前合计持有的字节数
+    static size_t TotalCachedBytes();
+
+private:
+    static int CurrentCpu()
+    {
+#ifdef CPUCACHE_HAVE_RSEQ
+        if (__rseq_size == 0)
+            return -1;
+        const struct rseq* rs = (const struct rseq*)((const char*)__builtin_thread_pointer() + __rseq_offset);
+        // 未注册或注册失败时为 (uint32)-1 / (uint32)-2
+        return (int)__atomic_load_n(&rs->cpu_id, __ATOMIC_RELAXED);
+#else
+        return -1;
+#endif
+    }
+
+    static CpuCache* Create(int cpu);
+
+    std::mutex _mtx;
+    ThreadCache _cache;
+
+    static std::atomic<CpuCache*> _caches[MAX_CPUS];
+    static std::atomic<bool> _disabled;
+};
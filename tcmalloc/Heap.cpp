@@ -0,0 +1,79 @@
+#include"Heap.h"
+#include<pthread.h>
+
+thread_local HeapCacheSlot TlsHeapCaches[Heap::MAX_HEAPS] TLS_INITIAL_EXEC;
+
+// 堆的登记表，由 heapMtx 保护；线程退出归还线程缓存与销毁堆都持有它，两者不会同时处理同一个缓存
+static std::mutex heapMtx;
+static Heap* heapSlots[Heap::MAX_HEAPS];
+static size_t heapNextGen = 1;
+static pthread_key_t heapKey;
+
+// 线程退出时：把它在仍然存在的堆上的线程缓存还回去；已销毁的堆的缓存已被一并丢弃
+void ReleaseThreadHeapCaches(void*) {
+    std::lock_guard<std::mutex> lg(heapMtx);
+    for (size_t id = 0; id < Heap::MAX_HEAPS; ++id) {
+        HeapCacheSlot& slot = TlsHeapCaches[id];
+        if (slot._tc == nullptr)
+            continue;
+        Heap* heap = heapSlots[id];
+        if (heap != nullptr && heap->_gen == slot._gen)
+            ThreadCache::Destroy(slot._tc);
+        slot._tc = nullptr;
+        slot._gen = 0;
+    }
+}
+
+static void CreateHeapKey() {
+    pthread_key_create(&heapKey, ReleaseThreadHeapCaches);
+}
+
+static size_t HeapPages() {
+    return SizeClass::_RoundUp(sizeof(Heap), (size_t)1 << PAGE_SHIFT) >> PAGE_SHIFT;
+}
+
+Heap::Heap(size_t id, size_t gen)
+    : _centralCache(&_pageCache)
+    , _id(id)
+    , _gen(gen)
+{}
+
+Heap* Heap::Create() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, CreateHeapKey);
+
+    std::lock_guard<std::mutex> lg(heapMtx);
+    for (size_t id = 0; id < MAX_HEAPS; ++id) {
+        if (heapSlots[id] == nullptr) {
+            // 堆对象本身也直接向系统要，销毁时一并还回去
+            Heap* heap = new (SystemAlloc(HeapPages())) Heap(id, heapNextGen++);
+            heapSlots[id] = heap;
+            return heap;
+        }
+    }
+    return nullptr;
+}
+
+void Heap::Destroy(Heap* heap) {
+    {
+        std::lock_guard<std::mutex> lg(heapMtx);
+        heapSlots[heap->_id] = nullptr;
+        ThreadCache::DiscardAll(&heap->_centralCache);
+    }
+
+    // 线程缓存、中转缓存里的对象都在中心缓存的span上，跟着span一起还给系统
+    heap->_pageCache.UnmapAll(heap->_centralCache._spanList, NFREELIST);
+
+    heap->~Heap();
+    SystemFree(heap, HeapPages());
+}
+
+ThreadCache* Heap::NewLocalCache() {
+    ThreadCache* tc = ThreadCache::Create(&_centralCache, &_transferCache);
+    HeapCacheSlot& slot = TlsHeapCaches[_id];
+    slot._tc = tc;
+    slot._gen = _gen;
+    // 值非空时线程退出才会调用 ReleaseThreadHeapCaches；退出钩子里再创建缓存时重新设置，pthread 会再调一轮
+    pthread_setspecific(heapKey, TlsHeapCaches);
+    return tc;
+}
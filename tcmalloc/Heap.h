@@ -0,0 +1,65 @@
+#pragma once
+
+#include"Common.h"
+#include"PageCache.h"
+#include"CentralCache.h"
+#include"TransferCache.h"
+#include"ThreadCache.h"
+
+// 独立的堆实例：自带页缓存、中心缓存、中转缓存，以及每个线程一份的线程缓存。
+// 不同的堆不共享任何锁和空闲内存，多租户服务可以每个租户一个堆，互不干扰；
+// 销毁堆时直接把它所有的span munmap 掉，不需要逐个释放对象。
+//
+// 用法见 ConcurrentAlloc(Heap*, size) / ConcurrentFree(Heap*, ptr)：
+//  - 从堆里申请的内存只能还给同一个堆，不能交给 ConcurrentFree(ptr)
+//  - Destroy 时不能再有线程在使用这个堆，之后它分配出去的指针全部失效
+class Heap
+{
+public:
+    static const size_t MAX_HEAPS = 128;   // 同时存在的堆的个数上限
+
+    // 创建一个堆，已有 MAX_HEAPS 个时返回nullptr
+    static Heap* Create();
+
+    // 丢弃各线程在这个堆上的线程缓存，把它所有的页还给系统
+    static void Destroy(Heap* heap);
+
+    PageCache* GetPageCache() {
+        return &_pageCache;
+    }
+
+    // 当前线程在这个堆上的线程缓存，首次使用时创建
+    ThreadCache* LocalCache();
+
+private:
+    Heap(size_t id, size_t gen);
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    ThreadCache* NewLocalCache();
+
+    friend void ReleaseThreadHeapCaches(void*);
+
+    PageCache _pageCache;
+    CentralCache _centralCache;
+    TransferCache _transferCache;
+
+    size_t _id;     // 在全局登记表和线程本地槽位里的下标
+    size_t _gen;    // 创建序号：槽位被新堆复用后，旧堆留下的线程缓存按序号识别出来
+};
+
+// 每个线程在各个堆上的线程缓存，按堆的 _id 下标；_gen 与堆的不一致说明是已销毁的旧堆留下的
+struct HeapCacheSlot
+{
+    ThreadCache* _tc;
+    size_t _gen;
+};
+
+extern thread_local HeapCacheSlot TlsHeapCaches[Heap::MAX_HEAPS] TLS_INITIAL_EXEC;
+
+inline ThreadCache* Heap::LocalCache() {
+    HeapCacheSlot& slot = TlsHeapCaches[_id];
+    if (slot._gen != _gen)
+        return NewLocalCache();
+    return slot._tc;
+}
@@ -0,0 +1,167 @@
+#include"ConcurrentAlloc.h"
+#include<new>
+#include<cerrno>
+
+// 以 C 接口导出 malloc 一族，和 NewDelete.cpp 一起编成 libconcurrentalloc.so，
+// 用 LD_PRELOAD 装入即可让现有程序(以及 glibc 内部的 strdup/fopen 等)改用内存池：
+//   LD_PRELOAD=./libconcurrentalloc.so ./a.out
+// 内存池内部只用 mmap 向系统要内存，不会反过来调用这里的函数
+// free/realloc/malloc_usable_size 只接受本库分配出去的指针
+
+#if defined(__GNUC__)
+#define ALLOC_EXPORT extern "C" __attribute__((visibility("default")))
+#else
+#define ALLOC_EXPORT extern "C"
+#endif
+
+// mmap 失败时内存池抛 std::bad_alloc，C 接口改为返回空指针并设置 errno
+static inline void* MallocImpl(size_t size) noexcept
+{
+	try
+	{
+		// 0 字节也要返回唯一地址
+		return ConcurrentAlloc(size == 0 ? 1 : size);
+	}
+	catch (...)
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+}
+
+static inline void* AlignedImpl(size_t alignment, size_t size) noexcept
+{
+	try
+	{
+		void* p = ConcurrentAlignedAlloc(alignment, size == 0 ? 1 : size);
+		if (p == nullptr)
+			errno = EINVAL;
+		return p;
+	}
+	catch (...)
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+}
+
+static inline bool IsPowerOfTwo(size_t n)
+{
+	return n != 0 && (n & (n - 1)) == 0;
+}
+
+ALLOC_EXPORT void* malloc(size_t size) noexcept
+{
+	return MallocImpl(size);
+}
+
+ALLOC_EXPORT void free(void* ptr) noexcept
+{
+	if (ptr)
+		ConcurrentFree(ptr);
+}
+
+ALLOC_EXPORT void* calloc(size_t num, size_t size) noexcept
+{
+	if (num == 0 || size == 0)
+		num = size = 1;
+	try
+	{
+		void* p = ConcurrentCalloc(num, size);
+		if (p == nullptr)
+			errno = ENOMEM;
+		return p;
+	}
+	catch (...)
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+}
+
+// 与 glibc 一致：realloc(ptr, 0) 释放并返回空指针
+ALLOC_EXPORT void* realloc(void* ptr, size_t size) noexcept
+{
+	try
+	{
+		return ConcurrentRealloc(ptr, size);
+	}
+	catch (...)
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+}
+
+ALLOC_EXPORT void* reallocarray(void* ptr, size_t num, size_t size) noexcept
+{
+	if (size != 0 && num > (size_t)-1 / size)
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+	return realloc(ptr, num * size);
+}
+
+// glibc 的 memalign 把不是2的幂的对齐向上取到2的幂
+ALLOC_EXPORT void* memalign(size_t alignment, size_t size) noexcept
+{
+	if (!IsPowerOfTwo(alignment))
+	{
+		size_t a = sizeof(void*);
+		while (a < alignment && a != 0)
+			a <<= 1;
+		if (a == 0)
+		{
+			errno = EINVAL;
+			return nullptr;
+		}
+		alignment = a;
+	}
+	return AlignedImpl(alignment, size);
+}
+
+ALLOC_EXPORT void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+	return AlignedImpl(alignment, size);
+}
+
+// 对齐必须是2的幂且是 sizeof(void*) 的倍数；失败时不设置 errno，而是返回错误码
+ALLOC_EXPORT int posix_memalign(void** memptr, size_t alignment, size_t size) noexcept
+{
+	if (!IsPowerOfTwo(alignment) || alignment % sizeof(void*) != 0)
+		return EINVAL;
+
+	int saved = errno;
+	void* p = AlignedImpl(alignment, size);
+	if (p == nullptr)
+	{
+		errno = saved;
+		return ENOMEM;
+	}
+	*memptr = p;
+	return 0;
+}
+
+ALLOC_EXPORT void* valloc(size_t size) noexcept
+{
+	return AlignedImpl((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+ALLOC_EXPORT void* pvalloc(size_t size) noexcept
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	return AlignedImpl(page, SizeClass::_RoundUp(size == 0 ? 1 : size, page));
+}
+
+ALLOC_EXPORT size_t malloc_usable_size(void* ptr) noexcept
+{
+	return ConcurrentUsableSize(ptr);
+}
+
+// 参数 pad 忽略；还了内存返回1，否则返回0
+ALLOC_EXPORT int malloc_trim(size_t pad) noexcept
+{
+	(void)pad;
+	return ConcurrentReleaseFreeMemory() > 0;
+}
@@ -0,0 +1,88 @@
+#include"ConcurrentAlloc.h"
+#include<new>
+
+// 将全局 operator new/delete 接到 ConcurrentAlloc/ConcurrentFree 上
+// 链接本文件的程序中，C++14 带大小的 delete 直接按大小归还ThreadCache，不查页表
+
+static inline void* NewImpl(size_t size)
+{
+	// 0 字节也要返回唯一地址
+	void* p = ConcurrentAlloc(size == 0 ? 1 : size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+static inline void* NewNothrowImpl(size_t size) noexcept
+{
+	try
+	{
+		return NewImpl(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+static inline void DeleteImpl(void* p) noexcept
+{
+	if (p)
+		ConcurrentFree(p);
+}
+
+static inline void DeleteSizedImpl(void* p, size_t size) noexcept
+{
+	if (p)
+		ConcurrentFree(p, size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size) { return NewImpl(size); }
+void* operator new[](size_t size) { return NewImpl(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return NewNothrowImpl(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return NewNothrowImpl(size); }
+
+void operator delete(void* p) noexcept { DeleteImpl(p); }
+void operator delete[](void* p) noexcept { DeleteImpl(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { DeleteImpl(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { DeleteImpl(p); }
+
+void operator delete(void* p, size_t size) noexcept { DeleteSizedImpl(p, size); }
+void operator delete[](void* p, size_t size) noexcept { DeleteSizedImpl(p, size); }
+
+#ifdef __cpp_aligned_new
+// C++17 对齐版本(alignas 超过 __STDCPP_DEFAULT_NEW_ALIGNMENT__ 的类型)走 ConcurrentAlignedAlloc
+// 对齐申请可能落在比 size 更大的类别里，带大小的 delete 也只能按页表查出真实大小
+
+static inline void* AlignedNewImpl(size_t size, std::align_val_t align)
+{
+	void* p = ConcurrentAlignedAlloc((size_t)align, size == 0 ? 1 : size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+static inline void* AlignedNewNothrowImpl(size_t size, std::align_val_t align) noexcept
+{
+	try
+	{
+		return AlignedNewImpl(size, align);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new(size_t size, std::align_val_t align) { return AlignedNewImpl(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return AlignedNewImpl(size, align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return AlignedNewNothrowImpl(size, align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return AlignedNewNothrowImpl(size, align); }
+
+void operator delete(void* p, std::align_val_t) noexcept { DeleteImpl(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { DeleteImpl(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { DeleteImpl(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { DeleteImpl(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { DeleteImpl(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { DeleteImpl(p); }
+#endif
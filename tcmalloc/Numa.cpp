@@ -0,0 +1,138 @@
+#include"Numa.h"
+#include"ThreadCache.h"
+#include<fcntl.h>
+#include<sched.h>
+#include<cstdio>
+#include<cstdlib>
+
+// BindCurrentThread 指定的分区，-1 表示按所在CPU决定
+static thread_local int TlsNumaNode TLS_INITIAL_EXEC = -1;
+
+// 读整个小文件到 buf(以'\0'结尾)，失败返回false
+static bool ReadSmallFile(const char* path, char* buf, size_t size)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    size_t len = 0;
+    while (len + 1 < size)
+    {
+        ssize_t n = read(fd, buf + len, size - 1 - len);
+        if (n <= 0)
+            break;
+        len += (size_t)n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return true;
+}
+
+// cpulist 形如 "0-3,8-11"，列出的CPU都归到分区 node；返回列出了几个CPU
+static size_t ParseCpuList(const char* s, uint8_t* cpuNodes, size_t node)
+{
+    size_t n = 0;
+    while (*s)
+    {
+        if (*s < '0' || *s > '9')
+        {
+            ++s;
+            continue;
+        }
+        char* end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        s = end;
+        if (*s == '-')
+        {
+            last = strtol(s + 1, &end, 10);
+            s = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < NumaPartitions::MAX_CPUS; ++cpu)
+        {
+            cpuNodes[cpu] = (uint8_t)node;
+            ++n;
+        }
+    }
+    return n;
+}
+
+template<class T>
+static size_t ObjectPages()
+{
+    return SizeClass::_RoundUp(sizeof(T), (size_t)1 << PAGE_SHIFT) >> PAGE_SHIFT;
+}
+
+const NumaPartitions::Topology* NumaPartitions::Discover(void* storage)
+{
+    Topology* t = new (storage) Topology();
+    t->_count = 1;
+    t->_pageCaches[0] = PageCache::GetInstance();
+    t->_centralCaches[0] = CentralCache::GetInstance();
+    t->_transferCaches[0] = TransferCache::GetInstance();
+    t->_systemNodes[0] = 0;
+
+    const char* env = getenv("TCMALLOC_NUMA");
+    if (env != nullptr && strcmp(env, "0") == 0)
+        return t;
+    const char* base = getenv("TCMALLOC_NUMA_SYSFS");
+    if (base == nullptr)
+        base = "/sys/devices/system/node";
+
+    // 先只记下节点号和CPU归属，够两个分区才真正建
+    uint8_t cpuNodes[MAX_CPUS] = {};
+    size_t count = 0;
+    for (int id = 0; id < MAX_SYSTEM_NODES && count < MAX_NODES; ++id)
+    {
+        char path[512];
+        char buf[4096];
+        snprintf(path, sizeof(path), "%s/node%d/cpulist", base, id);
+        if (!ReadSmallFile(path, buf, sizeof(buf)))
+            continue;
+        if (ParseCpuList(buf, cpuNodes, count) == 0)
+            continue;
+        t->_systemNodes[count++] = id;
+    }
+    if (count <= 1)
+        return t;
+
+    memcpy(t->_cpuNodes, cpuNodes, sizeof(cpuNodes));
+    t->_pageCaches[0]->_numaNode = t->_systemNodes[0];
+    for (size_t i = 1; i < count; ++i)
+    {
+        // 分区本身也直接向系统要，和全局的一样永不析构
+        PageCache* pc = new (SystemAlloc(ObjectPages<PageCache>())) PageCache;
+        pc->_numaNode = t->_systemNodes[i];
+        t->_pageCaches[i] = pc;
+        t->_centralCaches[i] = new (SystemAlloc(ObjectPages<CentralCache>())) CentralCache(pc);
+        t->_transferCaches[i] = new (SystemAlloc(ObjectPages<TransferCache>())) TransferCache;
+    }
+    t->_count = count;
+    return t;
+}
+
+size_t NumaPartitions::CurrentNode()
+{
+    const Topology& t = Get();
+    if (t._count == 1)
+        return 0;
+    if (TlsNumaNode >= 0)
+        return (size_t)TlsNumaNode;
+    int cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= MAX_CPUS)
+        return 0;
+    return t._cpuNodes[cpu];
+}
+
+void NumaPartitions::BindCurrentThread(size_t node)
+{
+    assert(node < Count());
+    TlsNumaNode = (int)node;
+
+    // 旧的线程缓存登记在线程退出钩子上，必须马上换成新的，不能留空等下次申请再建
+    ThreadCache* tc = TlsThreadCache;
+    if (tc != nullptr && tc->GetCentralCache() != GetCentralCache(node))
+    {
+        ThreadCache::Destroy(tc);
+        TlsThreadCache = ThreadCache::Create();
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include"Common.h"
+#include"PageCache.h"
+#include"CentralCache.h"
+#include"TransferCache.h"
+#include<cstdint>
+
+// NUMA 分区：每个内存节点一份页缓存/中心缓存/中转缓存，分区向系统要的页用 mbind 放在本节点上。
+// 线程缓存从所在节点的中心缓存补货；对象在别的节点上被释放时直接还给它所属分区的中心缓存，
+// 一个节点上释放的内存不会被另一个节点上的线程拿去用。
+//  - 拓扑在首次使用时从 /sys/devices/system/node/nodeN/cpulist 读取，环境变量 TCMALLOC_NUMA_SYSFS
+//    可以换成别的目录(测试时放一份假的拓扑)，TCMALLOC_NUMA=0 关闭；没有CPU的节点不建分区
+//  - 只有一个节点(或读不到拓扑)时只有0号分区，就是全局的页缓存/中心缓存/中转缓存，行为与原来一致
+//  - 0号分区之外的分区首次使用时建好，永不析构
+//  - 线程缓存按创建时所在CPU的节点绑定，线程之后被迁移到别的节点不会换绑；
+//    自己绑了核的线程可以用 BindCurrentThread 指定
+class NumaPartitions
+{
+public:
+    static const size_t MAX_NODES = 8;      // 分区个数上限，超出的节点不建分区
+    static const int MAX_SYSTEM_NODES = 64; // 扫描的系统节点号范围
+    static const int MAX_CPUS = 1024;
+
+    // 分区个数，单节点时为1
+    static size_t Count() {
+        return Get()._count;
+    }
+
+    // 当前线程所在的分区
+    static size_t CurrentNode();
+
+    static PageCache* GetPageCache(size_t node) {
+        return Get()._pageCaches[node];
+    }
+    static CentralCache* GetCentralCache(size_t node) {
+        return Get()._centralCaches[node];
+    }
+    static TransferCache* GetTransferCache(size_t node) {
+        return Get()._transferCaches[node];
+    }
+
+    // 分区对应的系统节点号
+    static int SystemNode(size_t node) {
+        return Get()._systemNodes[node];
+    }
+
+    // 对象所在的span，node 带回它所属的分区。各分区的页号映射互不重叠：
+    // 分区的页只会整段 munmap 后才可能被别的分区重新 mmap 到，munmap 前映射已经清掉
+    static Span* MapObjToSpan(void* obj, size_t& node) {
+        const Topology& t = Get();
+        if (t._count == 1) {
+            node = 0;
+            return t._pageCaches[0]->MapObjToSpan(obj);
+        }
+        for (size_t i = 0; i < t._count; ++i) {
+            if (Span* span = t._pageCaches[i]->FindSpan(obj)) {
+                node = i;
+                return span;
+            }
+        }
+        assert(false);
+        node = 0;
+        return nullptr;
+    }
+
+    // 把当前线程固定到分区 node：已有的线程缓存先归还，再按新分区重建
+    static void BindCurrentThread(size_t node);
+
+private:
+    struct Topology
+    {
+        size_t _count;
+        PageCache* _pageCaches[MAX_NODES];
+        CentralCache* _centralCaches[MAX_NODES];
+        TransferCache* _transferCaches[MAX_NODES];
+        int _systemNodes[MAX_NODES];
+        uint8_t _cpuNodes[MAX_CPUS];    // CPU号 -> 分区
+    };
+
+    static const Topology& Get() {
+        alignas(Topology) static char storage[sizeof(Topology)];
+        static const Topology* inst = Discover(storage);
+        return *inst;
+    }
+
+    // 读拓扑并建好各分区；这时可能正处在第一次 malloc 里，只能用系统调用读文件，不能申请内存
+    static const Topology* Discover(void* storage);
+};
@@ -28,29 +28,19 @@ public:
 			// 剩余内存不够一个对象大小时,重新申请大块内存
 			if (_remainBytes < sizeof(T))
 			{
-				// 根据对象大小动态调整分配块大小
-				// 小对象(< 256B): 128KB
-				// 中等对象(256B-4KB): 256KB  
-				// 大对象(> 4KB): 512KB
-				if (sizeof(T) <= 256)
-				{
-					_remainBytes = SMALL_BLOCK_SIZE;
-				}
-				else if (sizeof(T) <= 4096)
-				{
-					_remainBytes = MEDIUM_BLOCK_SIZE;
-				}
-				else
-				{
-					_remainBytes = LARGE_BLOCK_SIZE;
-				}
-
+				_remainBytes = BlockSize();
 				_memory = (char*)SystemAlloc(_remainBytes >> PAGE_SHIFT);
 				if (_memory == nullptr)
 				{
 					throw std::bad_alloc();
 				}
 				++_blockCount;
+
+				// 块首记录上一块，ReleaseAll 时顺着链表还给系统
+				NextObj(_memory) = _blocks;
+				_blocks = _memory;
+				_memory += BLOCK_HEADER;
+				_remainBytes -= BLOCK_HEADER;
 			}
 
 			obj = (T*)_memory;
@@ -85,6 +75,21 @@ public:
 		++_freeCount;
 	}
 
+	// 把申请过的所有大块还给系统，池中对象全部作废(不调用析构函数)
+	// 用于整体销毁的场景，例如销毁一个堆时丢弃它所有的Span对象
+	void ReleaseAll()
+	{
+		while (_blocks)
+		{
+			void* next = NextObj(_blocks);
+			SystemFree(_blocks, BlockSize() >> PAGE_SHIFT);
+			_blocks = next;
+		}
+		_memory = nullptr;
+		_remainBytes = 0;
+		_freeList = nullptr;
+	}
+
 	// 获取统计信息 - 用于性能分析和调试
 	size_t GetAllocCount() const { return _allocCount; }
 	size_t GetFreeCount() const { return _freeCount; }
@@ -96,7 +101,25 @@ public:
 	static const size_t MEDIUM_BLOCK_SIZE = 256 * 1024;  // 256KB
 	static const size_t LARGE_BLOCK_SIZE = 512 * 1024;   // 512KB
 
+	// 块首存放链接上一块的指针，对象从其后开始，保持T的对齐
+	static const size_t BLOCK_HEADER = alignof(T) > sizeof(void*) ? alignof(T) : sizeof(void*);
+
+	// 根据对象大小动态调整分配块大小
+	// 小对象(< 256B): 128KB
+	// 中等对象(256B-4KB): 256KB
+	// 大对象(> 4KB): 512KB
+	static size_t BlockSize()
+	{
+		if (sizeof(T) <= 256)
+			return SMALL_BLOCK_SIZE;
+		else if (sizeof(T) <= 4096)
+			return MEDIUM_BLOCK_SIZE;
+		else
+			return LARGE_BLOCK_SIZE;
+	}
+
 	char* _memory = nullptr;      // 指向当前大块内存的指针
+	void* _blocks = nullptr;      // 申请过的大块串成的链表
 	size_t _remainBytes = 0;      // 当前大块内存的剩余字节数
 	void* _freeList = nullptr;    // 自由链表头指针(已回收对象链表)
 
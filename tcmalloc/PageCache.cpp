@@ -1,34 +1,175 @@
 #include "PageCache.h"
+#include <atomic>
+#include <chrono>
+#include <sched.h>
 
-PageCache PageCache::_sInst;
+// 还页速度，UNSET 表示还没读环境变量
+static const size_t RELEASE_RATE_UNSET = (size_t)-1;
+static std::atomic<size_t> releaseRate{ RELEASE_RATE_UNSET };
+
+static uint64_t NowMs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 超大span缓存的树堆：按 (页数, 页号) 排序，优先级取页号的散列，_prev/_next 为左右孩子。
+// 树里的span键值不变，合并、切分前先摘下来
+static uint64_t LargePriority(const Span* span)
+{
+    return (uint64_t)span->_pageId * 0x9E3779B97F4A7C15ull;
+}
+
+static bool LargeLess(const Span* a, const Span* b)
+{
+    return a->_n != b->_n ? a->_n < b->_n : a->_pageId < b->_pageId;
+}
+
+static Span* LargeInsert(Span* root, Span* span)
+{
+    if (root == nullptr)
+    {
+        span->_prev = span->_next = nullptr;
+        return span;
+    }
+    if (LargeLess(span, root))
+    {
+        root->_prev = LargeInsert(root->_prev, span);
+        if (LargePriority(root->_prev) > LargePriority(root))
+        {
+            Span* left = root->_prev;
+            root->_prev = left->_next;
+            left->_next = root;
+            return left;
+        }
+    }
+    else
+    {
+        root->_next = LargeInsert(root->_next, span);
+        if (LargePriority(root->_next) > LargePriority(root))
+        {
+            Span* right = root->_next;
+            root->_next = right->_prev;
+            right->_prev = root;
+            return right;
+        }
+    }
+    return root;
+}
+
+// a 里的都排在 b 之前
+static Span* LargeJoin(Span* a, Span* b)
+{
+    if (a == nullptr)
+        return b;
+    if (b == nullptr)
+        return a;
+    if (LargePriority(a) > LargePriority(b))
+    {
+        a->_next = LargeJoin(a->_next, b);
+        return a;
+    }
+    b->_prev = LargeJoin(a, b->_prev);
+    return b;
+}
+
+static Span* LargeErase(Span* root, Span* span)
+{
+    assert(root != nullptr);
+    if (root == span)
+        return LargeJoin(span->_prev, span->_next);
+    if (LargeLess(span, root))
+        root->_prev = LargeErase(root->_prev, span);
+    else
+        root->_next = LargeErase(root->_next, span);
+    return root;
+}
+
+// 不少于k页里最小的，同样大小取地址低的
+static Span* LargeBestFit(Span* root, size_t k)
+{
+    Span* best = nullptr;
+    while (root != nullptr)
+    {
+        if (root->_n >= k)
+        {
+            best = root;
+            root = root->_prev;
+        }
+        else
+        {
+            root = root->_next;
+        }
+    }
+    return best;
+}
+
+static Span* LargeMax(Span* root)
+{
+    while (root != nullptr && root->_next != nullptr)
+        root = root->_next;
+    return root;
+}
+
+template<class F>
+static void LargeForEach(Span* root, F& f)
+{
+    if (root == nullptr)
+        return;
+    LargeForEach(root->_prev, f);
+    f(root);
+    LargeForEach(root->_next, f);
+}
 
 //获取一个k页的span
-Span *PageCache::NewSpan(size_t k) {
-    assert(k > 0);
+Span *PageCache::NewSpan(size_t k, size_t lane) {
+    assert(k > 0 && lane < NLANES);
 
     if(k > NPAGES - 1)
     {
-        void* ptr = SystemAlloc(k);
+        if(Span* span = TakeLargeSpan(k))
+            return span;
+        return NewHugeSpan(AllocPages(k), k);
+    }
 
-        Span*span = _spanPool.New();
-        span->_pageId = (PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT);
-        span->_n = k;
-        span->_isUse = true;
+    if(Span* kspan = PopFreeSpan(lane, k)) {
+        Recommit(kspan);
 
-        // 在用大页：逐页映射，保证 MapObjToSpan 命中
-        _pageMap.Ensure(span->_pageId, span->_n);
-        for (size_t i = 0; i < span->_n; ++i)
+        // 建立页号到span的映射（在用：逐页映射）
+        _pageMap.Ensure(kspan->_pageId, kspan->_n);
+        for(size_t i = 0; i < kspan->_n; ++i)
         {
-            _pageMap.set(span->_pageId + i, span);
+            _pageMap.set(kspan->_pageId + i, kspan);
         }
 
-        return span;
+        return kspan;
     }
 
-    if(!_spanLists[k].Empty()) {
-        Span* kspan = _spanLists[k].PopFront();
+    //检查后续是否有剩余的大块span：按位图直接找到最小的非空链表
+
+    size_t n = NextNonEmpty(lane, k + 1);
+    if(n < NPAGES)
+    {
+        Span* nspan = PopFreeSpan(lane, n);
+        //对span进行切分，还给系统过的剩余部分仍挂在还过的链表上
+        Span* kspan = _spanPool.New();
+        kspan->_pageId = nspan->_pageId;
+        kspan->_n = k;
+        kspan->_isZero = nspan->_isZero;
+        kspan->_lane = nspan->_lane;
+        kspan->_isReleased = nspan->_isReleased;
+
+        nspan->_pageId += k;
+        nspan->_n -= k;
+        LinkFreeSpan(nspan);
+        Recommit(kspan);
         
-        // 建立页号到span的映射（在用：逐页映射）
+        // 建立nspan的映射（空闲：仅首尾）
+        _pageMap.Ensure(nspan->_pageId, nspan->_n);
+        _pageMap.set(nspan->_pageId, nspan);
+        _pageMap.set(nspan->_pageId + nspan->_n - 1, nspan);
+        
+        // 建立kspan的映射（在用：逐页）
         _pageMap.Ensure(kspan->_pageId, kspan->_n);
         for(size_t i = 0; i < kspan->_n; ++i)
         {
@@ -38,53 +179,682 @@ Span *PageCache::NewSpan(size_t k) {
         return kspan;
     }
 
-    //检查后续是否有剩余的大块span
 
-    for(size_t i = k + 1; i < NPAGES; ++i)
+    // 大页模式至少要一整个大页，切成几个 NPAGES-1 页的span都挂进本组
+    static_assert(HUGE_PAGE_PAGES % (NPAGES - 1) == 0, "huge page must split into whole spans");
+    size_t pages;
+    char* ptr = CommitPages(_hugePage ? HUGE_PAGE_PAGES : NPAGES - 1, pages);
+    _pageMap.Ensure((PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT), pages);
+    // 倒着挂进链表，先切低地址的，预留区间由低到高用
+    for (size_t off = pages; off > 0; )
+    {
+        off -= NPAGES - 1;
+        Span* bigspan = _spanPool.New();
+        bigspan->_pageId = (PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT) + off;
+        bigspan->_n = NPAGES - 1;
+        bigspan->_isZero = true;
+        bigspan->_lane = (unsigned char)lane;
+
+        LinkFreeSpan(bigspan);
+
+        // 建立映射（空闲：仅首尾）
+        _pageMap.set(bigspan->_pageId, bigspan);
+        _pageMap.set(bigspan->_pageId + bigspan->_n - 1, bigspan);
+    }
+
+    return NewSpan(k, lane);
+}
+
+Span* PageCache::PopFreeSpan(size_t lane, size_t n) {
+    Span* span;
+    if (!_spanLists[lane][n].Empty())
+        span = _spanLists[lane][n].Begin();
+    else if (!_releasedLists[lane][n].Empty())
+        span = _releasedLists[lane][n].Begin();
+    else
+        return nullptr;
+    UnlinkFreeSpan(span);
+    return span;
+}
+
+void PageCache::LinkFreeSpan(Span* span) {
+    FreeList(span).PushFront(span);
+    _nonEmpty[span->_lane][span->_n / 64] |= (uint64_t)1 << (span->_n % 64);
+}
+
+void PageCache::UnlinkFreeSpan(Span* span) {
+    FreeList(span).Erase(span);
+    size_t lane = span->_lane, n = span->_n;
+    if (_spanLists[lane][n].Empty() && _releasedLists[lane][n].Empty())
+        _nonEmpty[lane][n / 64] &= ~((uint64_t)1 << (n % 64));
+}
+
+void PageCache::Recommit(Span* span) {
+    if (!span->_isReleased)
+        return;
+    SystemRecommit((void*)(span->_pageId << PAGE_SHIFT), span->_n);
+    span->_isReleased = false;
+    _releasedPages -= span->_n;
+}
+
+void PageCache::MarkReleased(Span* span, bool zero) {
+    assert(!span->_isUse && !span->_isReleased);
+    UnlinkFreeSpan(span);
+    span->_isReleased = true;
+    span->_isZero = span->_isZero || zero;
+    _releasedPages += span->_n;
+    LinkFreeSpan(span);
+}
+
+size_t PageCache::ReleaseHugePage(Span* span) {
+    // 大页里的空闲span不跨大页，逐个沿页号往后看是否首尾相接地铺满
+    PAGE_ID first = span->_pageId & ~(PAGE_ID)(HUGE_PAGE_PAGES - 1);
+    Span* spans[HUGE_PAGE_PAGES];
+    size_t count = 0;
+    for (PAGE_ID id = first; id < first + HUGE_PAGE_PAGES; )
+    {
+        Span* s = (Span*)_pageMap.get(id);
+        if (s == nullptr || s->_isUse || s->_pageId != id || s->_lane != span->_lane)
+            return 0;
+        spans[count++] = s;
+        id += s->_n;
+    }
+
+    // 已经还过的部分不算，一次 madvise 整个大页
+    bool zero = SystemRelease((void*)(first << PAGE_SHIFT), HUGE_PAGE_PAGES, _lazyRelease);
+    size_t released = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (spans[i]->_isReleased)
+            continue;
+        released += spans[i]->_n;
+        MarkReleased(spans[i], zero);
+    }
+    return released;
+}
+
+size_t PageCache::ReleaseLargeCache() {
+    size_t released = _largePages;
+    while (_largeRoot != nullptr)
+        EvictLargeSpan(LargeMax(_largeRoot));
+    return released;
+}
+
+size_t PageCache::ReleaseFreePages(size_t maxPages) {
+    size_t released = 0;
+    for (size_t n = NPAGES - 1; n > 0 && released < maxPages; --n)
     {
-        if(!_spanLists[i].Empty())
+        for (size_t lane = 0; lane < NLANES && released < maxPages; ++lane)
         {
-            //对span进行切分
-            Span* nspan = _spanLists[i].PopFront();
+            // 新挂回的在表头，从表尾往前是最久没用的
+            SpanList& list = _spanLists[lane][n];
+            Span* it = list.End()->_prev;
+            while (it != list.End() && released < maxPages)
+            {
+                Span* prev = it->_prev;
+                if (_hugePage)
+                {
+                    // 同一个大页里的其他span也会被挪走，prev 先跳过它们
+                    PAGE_ID hugeId = it->_pageId >> (HUGE_PAGE_SHIFT - PAGE_SHIFT);
+                    while (prev != list.End() && (prev->_pageId >> (HUGE_PAGE_SHIFT - PAGE_SHIFT)) == hugeId)
+                        prev = prev->_prev;
+                    released += ReleaseHugePage(it);
+                }
+                else
+                {
+                    bool zero = SystemRelease((void*)(it->_pageId << PAGE_SHIFT), it->_n, _lazyRelease);
+                    released += it->_n;
+                    MarkReleased(it, zero);
+                }
+                it = prev;
+            }
+        }
+    }
+    return released;
+}
 
-            Span* kspan = _spanPool.New();
-            kspan->_pageId = nspan->_pageId;
-            kspan->_n = k;
+void PageCache::SetReleaseRate(size_t bytesPerSecond) {
+    releaseRate.store(bytesPerSecond, std::memory_order_relaxed);
+}
 
-            nspan->_pageId += k;
-            nspan->_n -= k;
-            _spanLists[nspan->_n].PushFront(nspan);
-            
-            // 建立nspan的映射（空闲：仅首尾）
-            _pageMap.Ensure(nspan->_pageId, nspan->_n);
-            _pageMap.set(nspan->_pageId, nspan);
-            _pageMap.set(nspan->_pageId + nspan->_n - 1, nspan);
-            
-            // 建立kspan的映射（在用：逐页）
-            _pageMap.Ensure(kspan->_pageId, kspan->_n);
-            for(size_t i = 0; i < kspan->_n; ++i)
+size_t PageCache::GetReleaseRate() {
+    size_t rate = releaseRate.load(std::memory_order_relaxed);
+    if (rate == RELEASE_RATE_UNSET)
+    {
+        const char* env = getenv("TCMALLOC_RELEASE_RATE");
+        rate = env != nullptr ? strtoull(env, nullptr, 10) : DEFAULT_RELEASE_RATE;
+        size_t expected = RELEASE_RATE_UNSET;
+        if (!releaseRate.compare_exchange_strong(expected, rate, std::memory_order_relaxed))
+            rate = expected;
+    }
+    return rate;
+}
+
+void PageCache::ReleaseAmortized() {
+    if (_backgroundRelease.load(std::memory_order_relaxed))
+        return;
+    size_t rate = GetReleaseRate();
+    if (rate == 0)
+        return;
+    uint64_t now = NowMs();
+    if (_lastReleaseMs == 0)
+    {
+        _lastReleaseMs = now;
+        return;
+    }
+    uint64_t elapsed = now - _lastReleaseMs;
+    if (elapsed < RELEASE_INTERVAL_MS)
+        return;
+    _lastReleaseMs = now;
+    // 空闲很久后的第一次释放不补还欠下的量，持锁做的 madvise 有上限
+    elapsed = std::min(elapsed, (uint64_t)(RELEASE_INTERVAL_MS * MAX_RELEASE_INTERVALS));
+    ReleaseFreePages(std::max((size_t)(rate / 1000 * elapsed) >> PAGE_SHIFT, (size_t)1));
+}
+
+char* PageCache::CommitPages(size_t minPages, size_t& pages) {
+    if (_reserveCur == _reserveEnd && !_reserveOff)
+    {
+        size_t bytes = RESERVE_BYTES;
+        const char* env = getenv("TCMALLOC_RESERVE_BYTES");
+        if (env != nullptr)
+            bytes = strtoull(env, nullptr, 10);
+        // 按大页取整，各段提交的页数总能整除
+        size_t reservePages = SizeClass::_RoundUp(bytes, (size_t)1 << HUGE_PAGE_SHIFT) >> PAGE_SHIFT;
+        char* ptr = reservePages > 0 ? (char*)SystemReserve(reservePages) : nullptr;
+        if (ptr == nullptr)
+        {
+            _reserveOff = true;
+        }
+        else
+        {
+            _reserveCur = ptr;
+            _reserveEnd = ptr + (reservePages << PAGE_SHIFT);
+        }
+    }
+
+    char* ptr;
+    if (_reserveOff)
+    {
+        pages = minPages;
+        ptr = (char*)(_hugePage ? SystemAllocHuge(pages) : SystemAlloc(pages));
+    }
+    else
+    {
+        size_t left = (size_t)(_reserveEnd - _reserveCur) >> PAGE_SHIFT;
+        pages = std::min(std::max(_commitPages, minPages), left);
+        ptr = _reserveCur;
+        SystemCommit(ptr, pages);
+#ifdef MADV_HUGEPAGE
+        if (_hugePage)
+            madvise(ptr, pages << PAGE_SHIFT, MADV_HUGEPAGE);
+#endif
+        _reserveCur += pages << PAGE_SHIFT;
+        _commitPages = std::min(_commitPages * 2, MAX_COMMIT_PAGES);
+    }
+    if (_numaNode >= 0)
+        SystemBindNode(ptr, pages, _numaNode);
+    return ptr;
+}
+
+Span* PageCache::NewHugeSpan(void* ptr, size_t k) {
+    assert(k > NPAGES - 1);
+    k = LargePages(k);
+
+    Span*span = _spanPool.New();
+    span->_pageId = (PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT);
+    span->_n = k;
+    span->_isUse = true;
+    span->_isZero = true;
+    span->_isLarge = true;
+
+    // 在用大页：逐页映射，保证 MapObjToSpan 命中
+    _pageMap.Ensure(span->_pageId, span->_n);
+    for (size_t i = 0; i < span->_n; ++i)
+    {
+        _pageMap.set(span->_pageId + i, span);
+    }
+
+    return span;
+}
+
+PageCache::SpanShard& PageCache::CurrentShard() {
+    int cpu = sched_getcpu();
+    return _shards[cpu < 0 ? 0 : (size_t)cpu % NSHARDS];
+}
+
+Span* PageCache::NewSmallSpan(size_t size) {
+    size_t k = SizeClass::NumMovePage(size);
+    size_t alignPages = SizeClass::SpanAlignPages(size);
+    size_t lane = LaneOf(size);
+    if (!_sharded)
+    {
+        std::lock_guard<std::mutex> lg(_mtx);
+        Span* span = NewAlignedSpan(k, alignPages, lane);
+        span->_isUse = true;
+        span->_isPageSpan = false;
+        span->_objSize = size;
+        return span;
+    }
+
+    size_t index = SizeClass::Index(size);
+    SpanShard& shard = CurrentShard();
+    size_t room;
+    {
+        std::lock_guard<std::mutex> lg(shard._mtx);
+        if (Span* span = shard._spans[index])
+        {
+            shard._spans[index] = span->_next;
+            shard._pages -= span->_n;
+            span->_next = nullptr;
+            return span;
+        }
+        room = SHARD_MAX_PAGES - std::min(shard._pages, (size_t)SHARD_MAX_PAGES);
+    }
+
+    // 分片里没有：持一次页缓存锁要一批，多的留在分片里，留下的不超过分片还能放的页数
+    size_t batch = std::max(std::min(SHARD_BATCH_PAGES / k, room / k + 1), (size_t)1);
+    std::lock_guard<std::mutex> lg(_mtx);
+    Span* spans = nullptr;
+    for (size_t i = 0; i < batch; ++i)
+    {
+        Span* span = NewAlignedSpan(k, alignPages, lane);
+        span->_isUse = true;
+        span->_isPageSpan = false;
+        span->_objSize = size;
+        span->_next = spans;
+        spans = span;
+    }
+    Span* span = spans;
+    spans = spans->_next;
+    span->_next = nullptr;
+    if (spans != nullptr)
+    {
+        // 同一分片上别的线程可能在这期间放进了span，超过上限的部分趁持着页缓存锁直接还回去
+        std::lock_guard<std::mutex> slg(shard._mtx);
+        while (spans != nullptr)
+        {
+            Span* next = spans->_next;
+            if (shard._pages + spans->_n > SHARD_MAX_PAGES)
             {
-                _pageMap.set(kspan->_pageId + i, kspan);
+                spans->_next = nullptr;
+                ReleaseSpanToPageCache(spans);
             }
+            else
+            {
+                spans->_next = shard._spans[index];
+                shard._spans[index] = spans;
+                shard._pages += spans->_n;
+            }
+            spans = next;
+        }
+    }
+    return span;
+}
+
+void PageCache::ReleaseSmallSpan(Span* span) {
+    span->_freeList = nullptr;
+    span->_prev = nullptr;
+    if (!_sharded)
+    {
+        std::lock_guard<std::mutex> lg(_mtx);
+        ReleaseSpanToPageCache(span);
+        return;
+    }
 
-            return kspan;
+    size_t index = SizeClass::Index(span->_objSize);
+    SpanShard& shard = CurrentShard();
+    Span* flush = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(shard._mtx);
+        span->_next = shard._spans[index];
+        shard._spans[index] = span;
+        shard._pages += span->_n;
+        if (shard._pages > SHARD_MAX_PAGES)
+            flush = TakeShardSpans(shard);
+    }
+    if (flush != nullptr)
+        ReleaseSpanChain(flush);
+}
+
+Span* PageCache::TakeShardSpans(SpanShard& shard) {
+    Span* all = nullptr;
+    for (size_t i = 0; i < NFREELIST; ++i)
+    {
+        while (Span* span = shard._spans[i])
+        {
+            shard._spans[i] = span->_next;
+            span->_next = all;
+            all = span;
         }
     }
+    shard._pages = 0;
+    return all;
+}
+
+void PageCache::ReleaseSpanChain(Span* spans) {
+    std::lock_guard<std::mutex> lg(_mtx);
+    while (spans != nullptr)
+    {
+        Span* next = spans->_next;
+        spans->_next = nullptr;
+        ReleaseSpanToPageCache(spans);
+        spans = next;
+    }
+}
 
+void PageCache::FlushShards() {
+    for (SpanShard& shard : _shards)
+    {
+        Span* spans;
+        {
+            std::lock_guard<std::mutex> lg(shard._mtx);
+            spans = TakeShardSpans(shard);
+        }
+        if (spans != nullptr)
+            ReleaseSpanChain(spans);
+    }
+}
 
-    Span* bigspan = _spanPool.New();
-    void* ptr = SystemAlloc(NPAGES - 1);
-    bigspan->_pageId = (PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT);
-    bigspan->_n = NPAGES - 1;
+size_t PageCache::ShardPages() {
+    size_t pages = 0;
+    for (SpanShard& shard : _shards)
+    {
+        std::lock_guard<std::mutex> lg(shard._mtx);
+        pages += shard._pages;
+    }
+    return pages;
+}
 
-    _spanLists[NPAGES - 1].PushFront(bigspan);
-    
-    // 建立映射（空闲：仅首尾）
-    _pageMap.Ensure(bigspan->_pageId, bigspan->_n);
-    _pageMap.set(bigspan->_pageId, bigspan);
-    _pageMap.set(bigspan->_pageId + bigspan->_n - 1, bigspan);
+Span* PageCache::TakeLargeSpan(size_t k) {
+    assert(k > NPAGES - 1);
+    k = LargePages(k);
+    Span* span = LargeBestFit(_largeRoot, k);
+    if (span == nullptr)
+        return nullptr;
+    _largeRoot = LargeErase(_largeRoot, span);
+    _largePages -= span->_n;
 
-    return NewSpan(k);
+    // 切剩的尾部留在缓存里：仅首尾映射
+    if (span->_n > k)
+    {
+        Span* rest = _spanPool.New();
+        rest->_pageId = span->_pageId + k;
+        rest->_n = span->_n - k;
+        rest->_isZero = span->_isZero;
+        rest->_isLarge = true;
+        span->_n = k;
+        _pageMap.set(rest->_pageId, rest);
+        _pageMap.set(rest->_pageId + rest->_n - 1, rest);
+        _largeRoot = LargeInsert(_largeRoot, rest);
+        _largePages += rest->_n;
+    }
+
+    span->_isUse = true;
+    for (size_t i = 0; i < span->_n; ++i)
+    {
+        _pageMap.set(span->_pageId + i, span);
+    }
+    return span;
+}
+
+void PageCache::InsertLargeSpan(Span* span) {
+    // 在用时逐页映射，先全部清掉，合并完再设首尾
+    for (size_t i = 0; i < span->_n; ++i)
+    {
+        _pageMap.set(span->_pageId + i, nullptr);
+    }
+
+    // 缓存里相邻的超大span可能来自不同的 mmap，地址相接就能合并
+    Span* prev = (Span*)_pageMap.get(span->_pageId - 1);
+    if (prev != nullptr && !prev->_isUse && prev->_isLarge)
+    {
+        _largeRoot = LargeErase(_largeRoot, prev);
+        _largePages -= prev->_n;
+        _pageMap.set(prev->_pageId, nullptr);
+        _pageMap.set(prev->_pageId + prev->_n - 1, nullptr);
+        span->_pageId = prev->_pageId;
+        span->_n += prev->_n;
+        span->_isZero = span->_isZero && prev->_isZero;
+        _spanPool.Delete(prev);
+    }
+    Span* next = (Span*)_pageMap.get(span->_pageId + span->_n);
+    if (next != nullptr && !next->_isUse && next->_isLarge)
+    {
+        _largeRoot = LargeErase(_largeRoot, next);
+        _largePages -= next->_n;
+        _pageMap.set(next->_pageId, nullptr);
+        _pageMap.set(next->_pageId + next->_n - 1, nullptr);
+        span->_n += next->_n;
+        span->_isZero = span->_isZero && next->_isZero;
+        _spanPool.Delete(next);
+    }
+
+    span->_isUse = false;
+    _pageMap.set(span->_pageId, span);
+    _pageMap.set(span->_pageId + span->_n - 1, span);
+    _largeRoot = LargeInsert(_largeRoot, span);
+    _largePages += span->_n;
+
+    while (_largePages > _largeLimit)
+        EvictLargeSpan(LargeMax(_largeRoot));
+}
+
+void PageCache::EvictLargeSpan(Span* span) {
+    _largeRoot = LargeErase(_largeRoot, span);
+    _largePages -= span->_n;
+    _pageMap.set(span->_pageId, nullptr);
+    _pageMap.set(span->_pageId + span->_n - 1, nullptr);
+    SystemFree((void*)(span->_pageId << PAGE_SHIFT), span->_n);
+    _spanPool.Delete(span);
+}
+
+void PageCache::AdjustAligned(size_t& k, size_t& alignPages) const {
+    assert(k > 0);
+    assert((alignPages & (alignPages - 1)) == 0);
+    if (alignPages == 0)
+        alignPages = 1;
+    // 大页模式下超大的按大页对齐、整大页地切，不拆开大页
+    if (_hugePage && k + alignPages - 1 > NPAGES - 1)
+    {
+        alignPages = std::max(alignPages, HUGE_PAGE_PAGES);
+        k = LargePages(k);
+    }
+}
+
+size_t PageCache::AlignedPages(size_t k, size_t alignPages) const {
+    AdjustAligned(k, alignPages);
+    return k + alignPages - 1;
+}
+
+Span* PageCache::NewAlignedSpan(size_t k, size_t alignPages, size_t lane) {
+    if (alignPages <= 1)
+        return NewSpan(k, lane);
+
+    // 超大的取自超大span缓存或单独 mmap，首尾切下来的留在缓存里
+    AdjustAligned(k, alignPages);
+    return CutAligned(NewSpan(k + alignPages - 1, lane), k, alignPages);
+}
+
+Span* PageCache::TakeAlignedLargeSpan(size_t k, size_t alignPages) {
+    AdjustAligned(k, alignPages);
+    Span* span = TakeLargeSpan(k + alignPages - 1);
+    return span != nullptr ? CutAligned(span, k, alignPages) : nullptr;
+}
+
+Span* PageCache::NewAlignedHugeSpan(void* ptr, size_t k, size_t alignPages) {
+    AdjustAligned(k, alignPages);
+    return CutAligned(NewHugeSpan(ptr, k + alignPages - 1), k, alignPages);
+}
+
+Span* PageCache::CutAligned(Span* span, size_t k, size_t alignPages) {
+    span->_isUse = true;
+
+    PAGE_ID aligned = (span->_pageId + alignPages - 1) & ~(PAGE_ID)(alignPages - 1);
+    size_t head = aligned - span->_pageId;
+    size_t tail = span->_n - head - k;
+
+    // 首尾切下来的部分没交出去过，保留是否全0，登记后立即走合并流程挂回
+    if (head > 0)
+    {
+        Span* headSpan = _spanPool.New();
+        headSpan->_pageId = span->_pageId;
+        headSpan->_n = head;
+        headSpan->_isUse = true;
+        headSpan->_isZero = span->_isZero;
+        headSpan->_lane = span->_lane;
+        headSpan->_isLarge = span->_isLarge;
+        for (size_t i = 0; i < head; ++i)
+        {
+            _pageMap.set(headSpan->_pageId + i, headSpan);
+        }
+        span->_pageId = aligned;
+        InsertFreeSpan(headSpan);
+    }
+    if (tail > 0)
+    {
+        Span* tailSpan = _spanPool.New();
+        tailSpan->_pageId = aligned + k;
+        tailSpan->_n = tail;
+        tailSpan->_isUse = true;
+        tailSpan->_isZero = span->_isZero;
+        tailSpan->_lane = span->_lane;
+        tailSpan->_isLarge = span->_isLarge;
+        for (size_t i = 0; i < tail; ++i)
+        {
+            _pageMap.set(tailSpan->_pageId + i, tailSpan);
+        }
+        InsertFreeSpan(tailSpan);
+    }
+    span->_n = k;
+
+    return span;
+}
+
+void PageCache::ShrinkSpan(Span* span, size_t k) {
+    assert(k > 0 && k <= span->_n);
+    // 大页模式下超大span只在大页边界上切，切下的整大页进超大span缓存
+    if (_hugePage && span->_n > NPAGES - 1)
+        k = SizeClass::_RoundUp(span->_pageId + k, HUGE_PAGE_PAGES) - span->_pageId;
+    if (k >= span->_n)
+        return;
+
+    // 尾部作为在用span登记后立即释放：小的进空闲链表并合并，超大的进超大span缓存
+    Span* tailSpan = _spanPool.New();
+    tailSpan->_pageId = span->_pageId + k;
+    tailSpan->_n = span->_n - k;
+    tailSpan->_isUse = true;
+    tailSpan->_lane = span->_lane;
+    tailSpan->_isLarge = span->_isLarge;
+    for (size_t i = 0; i < tailSpan->_n; ++i)
+    {
+        _pageMap.set(tailSpan->_pageId + i, tailSpan);
+    }
+    span->_n = k;
+    ReleaseSpanToPageCache(tailSpan);
+}
+
+bool PageCache::GrowSpanInPlace(Span* span, size_t k) {
+    assert(k > span->_n);
+    if (span->_isLarge)
+        k = LargePages(k);
+
+    // 和 ReleaseSpanToPageCache 找右邻居的方式一样：空闲span的首页有映射
+    Span* nextSpan = (Span*)_pageMap.get(span->_pageId + span->_n);
+    if (nextSpan == nullptr || nextSpan->_isUse)
+        return false;
+    size_t need = k - span->_n;
+    if (nextSpan->_n < need)
+        return false;
+
+    // 超大span只吞并缓存里紧跟着的超大span，不受 NPAGES-1 页的限制
+    if (span->_isLarge || nextSpan->_isLarge)
+    {
+        if (!span->_isLarge || !nextSpan->_isLarge)
+            return false;
+        _largeRoot = LargeErase(_largeRoot, nextSpan);
+        _largePages -= nextSpan->_n;
+        _pageMap.set(nextSpan->_pageId + nextSpan->_n - 1, nullptr);
+        for (size_t i = 0; i < need; ++i)
+        {
+            _pageMap.set(nextSpan->_pageId + i, span);
+        }
+        span->_n = k;
+        if (nextSpan->_n == need)
+        {
+            _spanPool.Delete(nextSpan);
+        }
+        else
+        {
+            nextSpan->_pageId += need;
+            nextSpan->_n -= need;
+            _pageMap.set(nextSpan->_pageId, nextSpan);
+            _pageMap.set(nextSpan->_pageId + nextSpan->_n - 1, nextSpan);
+            _largeRoot = LargeInsert(_largeRoot, nextSpan);
+            _largePages += nextSpan->_n;
+        }
+        return true;
+    }
+
+    if (k > NPAGES - 1)
+        return false;
+    if (nextSpan->_lane != span->_lane || !SameHugePage(span->_pageId, span->_pageId + k - 1))
+        return false;
+
+    UnlinkFreeSpan(nextSpan);
+    _pageMap.set(nextSpan->_pageId, nullptr);
+    _pageMap.set(nextSpan->_pageId + nextSpan->_n - 1, nullptr);
+    // 吞下的页还给系统过的重新提交，剩下的部分保持原状
+    if (nextSpan->_isReleased)
+    {
+        SystemRecommit((void*)(nextSpan->_pageId << PAGE_SHIFT), need);
+        _releasedPages -= need;
+    }
+
+    // 吞下的页逐页映射到span(在用)
+    for (size_t i = 0; i < need; ++i)
+    {
+        _pageMap.set(nextSpan->_pageId + i, span);
+    }
+    span->_n = k;
+
+    if (nextSpan->_n == need)
+    {
+        _spanPool.Delete(nextSpan);
+    }
+    else
+    {
+        // 剩下的部分仍是空闲span：仅首尾映射
+        nextSpan->_pageId += need;
+        nextSpan->_n -= need;
+        LinkFreeSpan(nextSpan);
+        _pageMap.set(nextSpan->_pageId, nextSpan);
+        _pageMap.set(nextSpan->_pageId + nextSpan->_n - 1, nextSpan);
+    }
+    return true;
+}
+
+bool PageCache::RemapSpan(Span* span, size_t k) {
+    assert(span->_n > NPAGES - 1 && k > NPAGES - 1);
+    if (_hugePage)
+        return false;
+
+    void* ptr = SystemRemap((void*)(span->_pageId << PAGE_SHIFT), span->_n, k);
+    if (ptr == nullptr)
+        return false;
+
+    for (size_t i = 0; i < span->_n; ++i)
+    {
+        _pageMap.set(span->_pageId + i, nullptr);
+    }
+    span->_pageId = (PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT);
+    span->_n = k;
+
+    _pageMap.Ensure(span->_pageId, span->_n);
+    for (size_t i = 0; i < span->_n; ++i)
+    {
+        _pageMap.set(span->_pageId + i, span);
+    }
+    return true;
 }
 
 Span* PageCache::MapObjToSpan(void* obj)
@@ -97,20 +867,110 @@ Span* PageCache::MapObjToSpan(void* obj)
 }
 
 
-void PageCache::ReleaseSpanToPageCache(Span* span)
+void PageCache::MarkPageSpan(Span* span)
 {
+    span->_isPageSpan = true;
+    _pageSpans.PushFront(span);
+}
 
-    if(span->_n > NPAGES - 1)
+void PageCache::UnmapAll(SpanList* lists, size_t n)
+{
+    struct Range
     {
-        void* ptr = (void*)(span->_pageId << PAGE_SHIFT);
-        // 清理映射（逐页清空）
-        _pageMap.Ensure(span->_pageId, span->_n);
-        for (PAGE_ID pid = span->_pageId; pid < span->_pageId + span->_n; ++pid)
+        PAGE_ID _pageId;
+        size_t _n;
+    };
+
+    // 先数出span个数，向系统要一块临时数组记下所有区间
+    size_t count = 0;
+    auto countList = [&count](SpanList& list) {
+        for (Span* it = list.Begin(); it != list.End(); it = it->_next)
+            ++count;
+    };
+    for (size_t lane = 0; lane < NLANES; ++lane)
+        for (size_t i = 1; i < NPAGES; ++i)
         {
-            _pageMap.set(pid, nullptr);
+            countList(_spanLists[lane][i]);
+            countList(_releasedLists[lane][i]);
         }
-        SystemFree(ptr, span->_n);
-        _spanPool.Delete(span);
+    countList(_pageSpans);
+    for (size_t i = 0; i < n; ++i)
+        countList(lists[i]);
+    auto countLarge = [&count](Span*) { ++count; };
+    LargeForEach(_largeRoot, countLarge);
+    for (SpanShard& shard : _shards)
+        for (size_t i = 0; i < NFREELIST; ++i)
+            for (Span* it = shard._spans[i]; it != nullptr; it = it->_next)
+                ++count;
+
+    if (count > 0)
+    {
+        size_t pages = SizeClass::_RoundUp(count * sizeof(Range), (size_t)1 << PAGE_SHIFT) >> PAGE_SHIFT;
+        Range* ranges = (Range*)SystemAlloc(pages);
+        size_t m = 0;
+        auto collect = [ranges, &m](SpanList& list) {
+            for (Span* it = list.Begin(); it != list.End(); it = it->_next)
+                ranges[m++] = Range{ it->_pageId, it->_n };
+        };
+        for (size_t lane = 0; lane < NLANES; ++lane)
+            for (size_t i = 1; i < NPAGES; ++i)
+            {
+                collect(_spanLists[lane][i]);
+                collect(_releasedLists[lane][i]);
+            }
+        collect(_pageSpans);
+        for (size_t i = 0; i < n; ++i)
+            collect(lists[i]);
+        auto collectLarge = [ranges, &m](Span* it) { ranges[m++] = Range{ it->_pageId, it->_n }; };
+        LargeForEach(_largeRoot, collectLarge);
+        for (SpanShard& shard : _shards)
+            for (size_t i = 0; i < NFREELIST; ++i)
+                for (Span* it = shard._spans[i]; it != nullptr; it = it->_next)
+                    ranges[m++] = Range{ it->_pageId, it->_n };
+
+        // span 覆盖的页互不重叠，按地址排序后首尾相接的合成一段 munmap：
+        // 大量小span逐个 munmap 比释放所有对象还慢，而相邻的 mmap 往往连成一片
+        std::sort(ranges, ranges + m,
+            [](const Range& a, const Range& b) { return a._pageId < b._pageId; });
+        size_t i = 0;
+        while (i < m)
+        {
+            PAGE_ID start = ranges[i]._pageId;
+            PAGE_ID end = start + ranges[i]._n;
+            for (++i; i < m && ranges[i]._pageId == end; ++i)
+                end += ranges[i]._n;
+            SystemFree((void*)(start << PAGE_SHIFT), end - start);
+        }
+        SystemFree(ranges, pages);
+    }
+
+    // 预留了还没提交的部分
+    if (_reserveCur != _reserveEnd)
+        SystemFree(_reserveCur, (size_t)(_reserveEnd - _reserveCur) >> PAGE_SHIFT);
+
+    _spanPool.ReleaseAll();
+    _pageMap.ReleaseAll();
+}
+
+void PageCache::ReleaseSpanToPageCache(Span* span)
+{
+    if (span->_isPageSpan)
+    {
+        _pageSpans.Erase(span);
+        span->_isPageSpan = false;
+    }
+    // 用过的span内容已经不可信
+    span->_isZero = false;
+    InsertFreeSpan(span);
+    ReleaseAmortized();
+}
+
+void PageCache::InsertFreeSpan(Span* span)
+{
+
+    if(span->_isLarge)
+    {
+        InsertLargeSpan(span);
         return;
     }
     //返回的span合并成更大的页
@@ -124,7 +984,7 @@ void PageCache::ReleaseSpanToPageCache(Span* span)
             break;
         }
 
-        if(prev->_isUse)
+        if(prev->_isUse || prev->_isLarge)
         {
             break;
         }
@@ -132,6 +992,11 @@ void PageCache::ReleaseSpanToPageCache(Span* span)
         {
             break;
         }
+        // 只和同组、同一个大页里的合并
+        if(prev->_lane != span->_lane || !SameHugePage(prev->_pageId, span->_pageId))
+        {
+            break;
+        }
 
         // 清理前驱span的边界映射
         _pageMap.Ensure(prev->_pageId, prev->_n);
@@ -141,8 +1006,15 @@ void PageCache::ReleaseSpanToPageCache(Span* span)
         span->_pageId = prev->_pageId;
         
         span->_n += prev->_n;
+        span->_isZero = span->_isZero && prev->_isZero;
 
-        _spanLists[prev->_n].Erase(prev);
+        // 合并后整段按没还给系统算，还过的部分再访问时内核会重新分配
+        if (prev->_isReleased)
+        {
+            SystemRecommit((void*)(prev->_pageId << PAGE_SHIFT), prev->_n);
+            _releasedPages -= prev->_n;
+        }
+        UnlinkFreeSpan(prev);
         _spanPool.Delete(prev);
     }
 
@@ -155,12 +1027,16 @@ void PageCache::ReleaseSpanToPageCache(Span* span)
         {
             break;
         }
-		if (nextSpan->_isUse == true)
+		if (nextSpan->_isUse == true || nextSpan->_isLarge)
 		{
 			break;
 		}
 
 		if (nextSpan->_n + span->_n > NPAGES-1)
+		{
+			break;
+		}
+		if (nextSpan->_lane != span->_lane || !SameHugePage(nextSpan->_pageId, span->_pageId))
 		{
 			break;
 		}
@@ -171,8 +1047,14 @@ void PageCache::ReleaseSpanToPageCache(Span* span)
         _pageMap.set(nextSpan->_pageId + nextSpan->_n - 1, nullptr);
 
 		span->_n += nextSpan->_n;
+		span->_isZero = span->_isZero && nextSpan->_isZero;
 
-		_spanLists[nextSpan->_n].Erase(nextSpan);
+		if (nextSpan->_isReleased)
+		{
+			SystemRecommit((void*)(nextSpan->_pageId << PAGE_SHIFT), nextSpan->_n);
+			_releasedPages -= nextSpan->_n;
+		}
+		UnlinkFreeSpan(nextSpan);
         _spanPool.Delete(nextSpan);
 	}
 
@@ -186,8 +1068,8 @@ void PageCache::ReleaseSpanToPageCache(Span* span)
     _pageMap.set(span->_pageId, span);
     _pageMap.set(span->_pageId + span->_n - 1, span);
 
-    _spanLists[span->_n].PushFront(span);
     span->_isUse = false;
+    LinkFreeSpan(span);
 
 }
 
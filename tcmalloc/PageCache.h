@@ -2,31 +2,286 @@
 
 #include<mutex>
 #include<unordered_map>
+#include<new>
+#include<cstdlib>
 #include"Common.h"
 #include"ObjectPool.h"
 #include"PageMap.h"
 
 
+// 透明大页模式(环境变量 TCMALLOC_HUGEPAGE=1，在页缓存构造时读取)：
+//  - 空闲链表为空时一次向系统要一个2MB对齐、MADV_HUGEPAGE 的大页，切成 NPAGES-1 页的span
+//  - 空闲span按尺寸类别范围分组(LaneOf)，每组从自己的大页里切，同一范围的span挤在同一批大页里；
+//    合并只在同组、同一个大页以内进行，小span不会跨大页
+//  - 超大span按整大页单独 mmap(2MB对齐、MADV_HUGEPAGE)，页数向上取整到大页；从缓存里切、
+//    原地缩小/扩大都只在大页边界上切，不拆开大页；mremap 的新地址不保证对齐，不用它
+// 不开启时只有0组，行为与原来一致
+//
+// 空闲链表不够时不再每次 mmap 512KB：首次补货时预留一大段连续的虚拟地址(PROT_NONE + MAP_NORESERVE，
+// 默认 RESERVE_BYTES，环境变量 TCMALLOC_RESERVE_BYTES 调整，0 关闭)，之后从低到高分段提交，
+// 每段是上一段的两倍(最多 MAX_COMMIT_PAGES 页)。系统调用更少，页号连续，相邻span更容易合并；
+// 用完再预留下一段，预留失败退回逐次 mmap
+//
+// 空闲span的物理页可以还给系统(ReleaseFreePages)：保留映射只做 madvise，span 标记 _isReleased
+// 挂到单独的链表上，取span时先用没还过的，还过的再次使用不需要额外处理(访问时内核重新分配页)。
+// 还的速度由 SetReleaseRate 控制(环境变量 TCMALLOC_RELEASE_RATE，字节/秒，0 关闭)：
+// 后台清理线程在跑时由它按速度还各分区的页缓存，否则(以及独立堆的页缓存)在释放span时
+// 按距上次过去的时间顺带还一些
+//
+// 超过 NPAGES-1 页的申请单独向系统要，释放后不马上 munmap，而是留在超大span缓存里：
+// 相邻的合并，按页数最佳适配取用(切剩的留在缓存里)。缓存总量超过 LARGE_CACHE_BYTES
+// (环境变量 TCMALLOC_LARGE_CACHE_BYTES 调整，0 不缓存)时从最大的开始还给系统。
+// 按速度还页不碰这里(刚释放的超大span往往马上又要用)，只有显式 ReleaseLargeCache 时全部还掉
+//
+// 中心缓存补货/归还不直接碰页缓存锁，而是经过按CPU分的 NSHARDS 个分片：分片按尺寸类别留着
+// 切小对象用的span(对页缓存来说仍在用)，取不到时持一次页缓存锁补一批(最多 SHARD_BATCH_PAGES 页)，
+// 收回的span先还到分片，分片超过 SHARD_MAX_PAGES 页时整个还给页缓存。不同CPU上不同类别的补货
+// 不再都挤在页缓存锁上。环境变量 TCMALLOC_SPAN_SHARDS=0 关闭，直接走页缓存
 class PageCache {
 public:
-    static PageCache* GetInstance() {
-        return &_sInst;
-    }
+    static const size_t NLANES = 3;
+    static const size_t BITMAP_WORDS = (NPAGES + 63) / 64;
+    static const size_t RESERVE_BYTES = (size_t)4 << 30;
+    static const size_t MAX_COMMIT_PAGES = (32 * 1024 * 1024) >> PAGE_SHIFT;
+    static const size_t DEFAULT_RELEASE_RATE = 8 * 1024 * 1024;
+    static const size_t RELEASE_INTERVAL_MS = 100;  // 顺带还页的最小间隔
+    static const size_t MAX_RELEASE_INTERVALS = 10; // 顺带还页一次最多按几个间隔的量还
+    static const size_t LARGE_CACHE_BYTES = 64 * 1024 * 1024;
+    static const size_t NSHARDS = 16;
+    static const size_t SHARD_MAX_PAGES = 256;
+    static const size_t SHARD_BATCH_PAGES = 128;
+
+    static PageCache* GetInstance();
 
     std::mutex& Getmtx() {
         return _mtx;
     }
 
-    Span* NewSpan(size_t k);
+    //获取一个k页的span，lane 为从哪一组的空闲链表取(见 LaneOf)
+    Span* NewSpan(size_t k, size_t lane = 0);
+
+    //把一段已经 SystemAlloc 好的k页(超过 NPAGES-1 页)内存登记成在用span；
+    //调用者可以先在锁外 mmap，再持锁登记
+    Span* NewHugeSpan(void* ptr, size_t k);
+
+    //从超大span缓存里按最佳适配取k页的在用span，缓存里没有够大的返回nullptr；
+    //调用者先持锁试这里，取不到再在锁外 mmap 后 NewHugeSpan
+    Span* TakeLargeSpan(size_t k);
+
+    //获取一个起始页号按alignPages(2的幂)对齐的k页span：多要alignPages-1页，
+    //切掉首尾不对齐的部分还回页缓存
+    Span* NewAlignedSpan(size_t k, size_t alignPages, size_t lane = 0);
+
+    //对齐申请要切的原始span的页数(k页加对齐余量，大页模式下超大的按大页取整)，
+    //超过 NPAGES-1 页时调用者照 TakeLargeSpan/NewHugeSpan 的方式在锁外 mmap：
+    //先持锁 TakeAlignedLargeSpan，取不到在锁外 AllocPages(AlignedPages(...))，再持锁 NewAlignedHugeSpan
+    size_t AlignedPages(size_t k, size_t alignPages) const;
+    Span* TakeAlignedLargeSpan(size_t k, size_t alignPages);
+    Span* NewAlignedHugeSpan(void* ptr, size_t k, size_t alignPages);
+
+    //中心缓存补货：取一个切 size 大小对象用的在用span，先从当前CPU的分片取。不需要持锁
+    Span* NewSmallSpan(size_t size);
+
+    //中心缓存里对象全部收回的span还回当前CPU的分片，分片满时整个还给页缓存。不需要持锁
+    void ReleaseSmallSpan(Span* span);
+
+    //把所有分片里的span还给页缓存。不能持页缓存锁调用
+    void FlushShards();
 
-    //获取从对象到span的映射
+    //所有分片里留着的页数。不能持页缓存锁调用
+    size_t ShardPages();
+
+    //在用span原地缩小到k页，切下的尾部还回页缓存
+    void ShrinkSpan(Span* span, size_t k);
+
+    //吞并紧跟在后面的空闲span，把在用span原地扩大到k页；后面不是足够大的空闲span时返回false
+    bool GrowSpanInPlace(Span* span, size_t k);
+
+    //超过 NPAGES-1 页的span用 mremap 调整到k页(可能搬到新地址)；span 由缓存里相邻的几段
+    //映射拼成时 mremap 会失败，返回false，span 不变；大页模式下新地址不保证对齐，也返回false
+    bool RemapSpan(Span* span, size_t k);
+
+    //获取从对象到span的映射（无锁：基数树节点与叶子均为原子指针）
+    //调用者需保证obj所在span仍在使用中，在用span的每一页映射在其生命周期内不变
     Span* MapObjToSpan(void* obj);
 
+    //同 MapObjToSpan，但页号没有映射时返回nullptr(NUMA 分区按它找对象属于哪个分区)
+    Span* FindSpan(void* obj) {
+        return (Span*)_pageMap.get((PAGE_ID)((uintptr_t)obj >> PAGE_SHIFT));
+    }
+
+    //向系统要k页给span用，属于某个NUMA节点的分区时绑定到该节点；不需要持锁
+    //大页模式下按 LargePages(k) 页、2MB对齐地要，之后 NewHugeSpan 用同一个k登记
+    void* AllocPages(size_t k) {
+        k = LargePages(k);
+        void* ptr = _hugePage ? SystemAllocHuge(k) : SystemAlloc(k);
+        if (_numaNode >= 0)
+            SystemBindNode(ptr, k, _numaNode);
+        return ptr;
+    }
+
 	// 释放空闲span回到Pagecache，并合并相邻的span
 	void ReleaseSpanToPageCache(Span* span);
 
+    //是否为透明大页模式
+    bool HugePageMode() const {
+        return _hugePage;
+    }
+
+    //切成 objSize 大小对象的span取自哪一组：0组是页级span(大对象、对齐申请、区域分配)，
+    //1组是1KB以内的小对象，2组是其余的小对象；不是大页模式时都在0组
+    size_t LaneOf(size_t objSize) const {
+        if (!_hugePage)
+            return 0;
+        return objSize <= 1024 ? 1 : 2;
+    }
+
+    //把在用span整个交给一次申请(大对象或大对齐)：标记 _isPageSpan 并登记，
+    //释放时由 ReleaseSpanToPageCache 注销
+    void MarkPageSpan(Span* span);
+
+    //把空闲span的物理页还给系统，最多 maxPages 页，先还大的、久未使用的；不碰超大span缓存。
+    //返回实际还了多少页。
+    //大页模式下只还整个空闲的大页，不拆开大页。调用者持锁
+    size_t ReleaseFreePages(size_t maxPages);
+
+    //把超大span缓存里的span全部 munmap，返回还了多少页。调用者持锁
+    size_t ReleaseLargeCache();
+
+    //已经还给系统的空闲页数。调用者持锁
+    size_t ReleasedPages() const {
+        return _releasedPages;
+    }
+
+    //超大span缓存里的页数。调用者持锁
+    size_t LargeCachedPages() const {
+        return _largePages;
+    }
+
+    //所有页缓存共用的还页速度(字节/秒)，0 表示不按速度还，只在显式调用时还
+    static void SetReleaseRate(size_t bytesPerSecond);
+    static size_t GetReleaseRate();
+
+    //后台清理线程是否在按速度还这个页缓存的页，在还时释放span不再顺带还
+    void SetBackgroundRelease(bool on) {
+        _backgroundRelease.store(on, std::memory_order_relaxed);
+    }
+
+    //把空闲span、登记的页级span以及 lists 里的span(中心缓存的)全部 munmap，
+    //并丢弃Span对象池与页号映射，之后本对象不能再使用；只用于销毁整个堆(Heap)
+    void UnmapAll(SpanList* lists, size_t n);
+
 private:
-    PageCache() {}
+    // 把空闲span挂回空闲链表并与相邻空闲span合并，合并后只有都没被写过才算全0；
+    // 超过 NPAGES-1 页的直接还给系统
+    void InsertFreeSpan(Span* span);
+
+    // 空闲span当前所在的链表：按组、页数以及是否已还给系统
+    SpanList& FreeList(Span* span) {
+        return span->_isReleased ? _releasedLists[span->_lane][span->_n] : _spanLists[span->_lane][span->_n];
+    }
+
+    // 取一个组 lane 里n页的空闲span，先取没还给系统的；没有返回nullptr
+    Span* PopFreeSpan(size_t lane, size_t n);
+
+    // 空闲span挂进/摘出所在链表，同时维护非空位图
+    void LinkFreeSpan(Span* span);
+    void UnlinkFreeSpan(Span* span);
+
+    // 组 lane 里页数不小于n的最小非空链表(没还过的或还过的)，都为空返回 NPAGES
+    size_t NextNonEmpty(size_t lane, size_t n) const {
+        for (size_t w = n / 64; w < BITMAP_WORDS; ++w) {
+            uint64_t bits = _nonEmpty[lane][w];
+            if (w == n / 64)
+                bits &= ~(uint64_t)0 << (n % 64);
+            if (bits != 0)
+                return w * 64 + FindFirstSet(bits);
+        }
+        return NPAGES;
+    }
+
+    // 对齐申请的页数与对齐：alignPages 为0当作1，大页模式下超大的按大页对齐、整大页取整
+    void AdjustAligned(size_t& k, size_t& alignPages) const;
+
+    // 从 span 里切出起始页号按 alignPages 对齐的k页在用span，首尾切下的挂回
+    Span* CutAligned(Span* span, size_t k, size_t alignPages);
+
+    // 从空闲链表取出的span要交出去前调用：还给系统过的重新提交
+    void Recommit(Span* span);
+
+    // 把空闲span标记为已还给系统，挂到还过的链表上(madvise 由调用者做)，zero 为之后是否全0
+    void MarkReleased(Span* span, bool zero);
+
+    // 还 span 所在的整个大页，不是整个都空闲时返回0
+    size_t ReleaseHugePage(Span* span);
+
+    // 释放span时按距上次过去的时间顺带还页
+    void ReleaseAmortized();
+
+    struct alignas(64) SpanShard
+    {
+        std::mutex _mtx;
+        Span* _spans[NFREELIST] = {};   // 按尺寸类别，_next 串起来
+        size_t _pages = 0;
+    };
+
+    // 当前CPU对应的分片
+    SpanShard& CurrentShard();
+
+    // 取走分片里所有的span，_next 串成一条。调用者持分片锁
+    static Span* TakeShardSpans(SpanShard& shard);
+
+    // 持页缓存锁把 TakeShardSpans 取出的span都还回去
+    void ReleaseSpanChain(Span* spans);
+
+    // 空闲的超大span放进缓存并与相邻的合并，超过保留上限时从最大的开始还给系统
+    void InsertLargeSpan(Span* span);
+
+    // 把缓存里的超大span还给系统
+    void EvictLargeSpan(Span* span);
+
+    // 补货：从预留区间提交至少 minPages 页(预留失败时直接向系统要)，pages 带回实际拿到的页数，
+    // 是 minPages 的整数倍
+    char* CommitPages(size_t minPages, size_t& pages);
+
+    // 超大span实际用的页数：大页模式下向上取整到整大页
+    size_t LargePages(size_t k) const {
+        return _hugePage ? SizeClass::_RoundUp(k, HUGE_PAGE_PAGES) : k;
+    }
+
+    // 大页模式下两个页号是否落在同一个大页里；不是大页模式时不限制
+    bool SameHugePage(PAGE_ID a, PAGE_ID b) const {
+        return !_hugePage || (a >> (HUGE_PAGE_SHIFT - PAGE_SHIFT)) == (b >> (HUGE_PAGE_SHIFT - PAGE_SHIFT));
+    }
+
+    static bool HugePageEnabled() {
+        const char* env = getenv("TCMALLOC_HUGEPAGE");
+        return env != nullptr && strcmp(env, "1") == 0;
+    }
+
+    friend class Heap;
+    friend class NumaPartitions;
+    static bool LazyReleaseEnabled() {
+        const char* env = getenv("TCMALLOC_MADV_FREE");
+        return env != nullptr && strcmp(env, "1") == 0;
+    }
+
+    static size_t LargeCacheLimit() {
+        const char* env = getenv("TCMALLOC_LARGE_CACHE_BYTES");
+        return (env != nullptr ? strtoull(env, nullptr, 10) : LARGE_CACHE_BYTES) >> PAGE_SHIFT;
+    }
+
+    static bool ShardsEnabled() {
+        const char* env = getenv("TCMALLOC_SPAN_SHARDS");
+        return env == nullptr || strcmp(env, "0") != 0;
+    }
+
+    PageCache()
+        : _hugePage(HugePageEnabled())
+        , _lazyRelease(LazyReleaseEnabled())
+        , _largeLimit(LargeCacheLimit())
+        , _sharded(ShardsEnabled())
+    {}
     PageCache(const PageCache &) = delete;
     PageCache &operator=(const PageCache &) = delete;
     ~PageCache() {}
@@ -35,10 +290,44 @@ private:
 
     std::mutex _mtx;
 
-    static PageCache _sInst;
-
-    SpanList _spanLists[NPAGES];
+    SpanList _spanLists[NLANES][NPAGES];
+    SpanList _releasedLists[NLANES][NPAGES];   // 物理页已还给系统的空闲span
+    // 第n位表示 _spanLists[lane][n] 与 _releasedLists[lane][n] 至少一个非空，
+    // 切分时不用逐个链表往后找
+    uint64_t _nonEmpty[NLANES][BITMAP_WORDS] = {};
+    SpanList _pageSpans;    // 在用的页级span，销毁堆时按它找回交给用户的大块
     std::unordered_map<PAGE_ID,Span*> _idSpanMap;
 
     TCMalloc_PageMap3<64 - PAGE_SHIFT> _pageMap;
-};
\ No newline at end of file
+
+    int _numaNode = -1;     // 新要的页绑定到的系统NUMA节点号，-1 不绑定
+    bool _hugePage;
+
+    // 预留区间里尚未提交的部分 [_reserveCur, _reserveEnd)
+    char* _reserveCur = nullptr;
+    char* _reserveEnd = nullptr;
+    size_t _commitPages = NPAGES - 1;   // 下一段提交的页数
+    bool _reserveOff = false;           // 关闭或预留失败，退回逐次 mmap
+
+    size_t _releasedPages = 0;
+    bool _lazyRelease;                  // 用 MADV_FREE 还页(环境变量 TCMALLOC_MADV_FREE=1)
+    uint64_t _lastReleaseMs = 0;        // 上次顺带还页的时间
+    std::atomic<bool> _backgroundRelease{ false };  // 后台清理线程在替它还页
+
+    // 超大span缓存：按 (页数, 页号) 排序的树堆，空闲的超大span不在任何链表上，
+    // _prev/_next 用作左右孩子
+    Span* _largeRoot = nullptr;
+    size_t _largePages = 0;
+    size_t _largeLimit;                 // 缓存页数上限
+
+    bool _sharded;
+    SpanShard _shards[NSHARDS];
+};
+
+// 首次使用时在静态存储上构造且永不析构：替换全局operator new后，
+// 其他编译单元的静态构造/析构期间也可能调用到这里
+inline PageCache* PageCache::GetInstance() {
+    alignas(PageCache) static char storage[sizeof(PageCache)];
+    static PageCache* inst = new (storage) PageCache;
+    return inst;
+}
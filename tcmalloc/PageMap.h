@@ -143,6 +143,10 @@ private:
 	Node* root_;                          // Root of radix tree
 	void* (*allocator_)(size_t);          // Memory allocator
 
+	// Ensure 过的页号范围，ReleaseAll 只扫这一段，不必把2MB的根节点整个读一遍
+	uintptr_t minKey_ = ~(uintptr_t)0;
+	uintptr_t maxKey_ = 0;
+
 	static void* DefaultAlloc(size_t bytes) {
 		size_t pages = (bytes + ((size_t)1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
 		return SystemAlloc(pages);
@@ -198,6 +202,8 @@ public:
     }
 
 	bool Ensure(Number start, size_t n) {
+		minKey_ = std::min(minKey_, start);
+		maxKey_ = std::max(maxKey_, (Number)(start + n - 1));
 		for (Number key = start; key <= start + n - 1;) {
 			const Number i1 = key >> (LEAF_BITS + INTERIOR_BITS);
 			const Number i2 = (key >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
@@ -232,4 +238,28 @@ public:
 	void PreallocateMoreMemory() {
         
 	}
+
+	// 把所有节点还给系统，之后不能再使用；只适用于默认的 DefaultAlloc 分配的节点
+	void ReleaseAll() {
+		// 节点只会在 [minKey_, maxKey_] 覆盖的下标上出现
+		const Number lo = minKey_ >> LEAF_BITS, hi = maxKey_ >> LEAF_BITS;
+		for (Number i1 = lo >> INTERIOR_BITS; minKey_ <= maxKey_ && i1 <= (hi >> INTERIOR_BITS); ++i1) {
+			Node* p1 = root_->ptrs[i1].load(std::memory_order_relaxed);
+			if (p1 == nullptr) continue;
+			Number first = i1 == (lo >> INTERIOR_BITS) ? (lo & (INTERIOR_LENGTH - 1)) : 0;
+			Number last = i1 == (hi >> INTERIOR_BITS) ? (hi & (INTERIOR_LENGTH - 1)) : INTERIOR_LENGTH - 1;
+			for (Number i2 = first; i2 <= last; ++i2) {
+				Node* p2 = p1->ptrs[i2].load(std::memory_order_relaxed);
+				if (p2 != nullptr) DefaultFree(p2, sizeof(Leaf));
+			}
+			DefaultFree(p1, sizeof(Node));
+		}
+		DefaultFree(root_, sizeof(Node));
+		root_ = nullptr;
+	}
+
+private:
+	static void DefaultFree(void* p, size_t bytes) {
+		SystemFree(p, (bytes + ((size_t)1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include"Region.h"
+
+void* Region::AllocateSlow(size_t bytes, size_t alignment)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        throw std::bad_alloc();
+    if (bytes > (size_t)PTRDIFF_MAX || alignment > (size_t)PTRDIFF_MAX - bytes)
+        throw std::bad_alloc();
+
+    // 块首放 Chunk，再按对齐留出余量
+    size_t need = sizeof(Chunk) + alignment - 1 + bytes;
+    size_t needPages = SizeClass::_RoundUp(need, (size_t)1 << PAGE_SHIFT) >> PAGE_SHIFT;
+    size_t pages = needPages > _nextPages ? needPages : _nextPages;
+    if (pages == _nextPages && _nextPages < NPAGES - 1)
+        _nextPages = std::min(_nextPages * 2, NPAGES - 1);
+
+    // 超过 NPAGES-1 页的先从超大span缓存取，没有再在锁外 mmap，原因同 LargeAlloc
+    Span* span = nullptr;
+    {
+        std::unique_lock<std::mutex> ul(_pageCache->Getmtx());
+        span = pages > NPAGES - 1 ? _pageCache->TakeLargeSpan(pages) : _pageCache->NewSpan(pages);
+        if (span == nullptr)
+        {
+            ul.unlock();
+            void* mem = _pageCache->AllocPages(pages);
+            ul.lock();
+            span = _pageCache->NewHugeSpan(mem, pages);
+        }
+        span->_objSize = pages << PAGE_SHIFT;
+        span->_isUse = true;
+        _pageCache->MarkPageSpan(span);
+    }
+    _reserved += pages << PAGE_SHIFT;
+
+    Chunk* chunk = (Chunk*)(span->_pageId << PAGE_SHIFT);
+    chunk->_prev = _chunks;
+    chunk->_span = span;
+    _chunks = chunk;
+
+    char* end = (char*)chunk + (pages << PAGE_SHIFT);
+    char* p = (char*)(((uintptr_t)(chunk + 1) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+
+    // 新块剩得更多才换过去：单独放一个大申请的span用完就满了，当前块剩下的还能接着用
+    if ((size_t)(end - p) - bytes >= (size_t)(_end - _cur))
+    {
+        _cur = p + bytes;
+        _end = end;
+    }
+    return p;
+}
+
+void Region::Reset()
+{
+    if (_chunks == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lg(_pageCache->Getmtx());
+    while (_chunks)
+    {
+        // 超大的span归还时可能被 munmap，先取出链表指针
+        Chunk* prev = _chunks->_prev;
+        _pageCache->ReleaseSpanToPageCache(_chunks->_span);
+        _chunks = prev;
+    }
+    _cur = nullptr;
+    _end = nullptr;
+    _reserved = 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include"Common.h"
+#include"PageCache.h"
+#include"Numa.h"
+#include<cstddef>
+#include<cstdint>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include<memory_resource>
+#define REGION_HAVE_PMR 1
+#endif
+#endif
+
+// 单调区域分配器：向页缓存整块要span，在块内移动指针分配，对象不带任何头部信息，也不单独释放；
+// Reset 或析构时持一次页缓存锁把所有span还回去，适合请求/会话级别的临时内存。
+//  - 块从 MIN_REGION_PAGES 页开始，每次翻倍，最大 NPAGES-1 页；放不下的大申请单独一个span
+//  - span 以页级span的身份登记，建在 Heap 的页缓存上时，Heap::Destroy 也能找到它们
+//    (此时 Region 必须先于 Heap 析构或不再使用)
+//  - 默认建在创建它的线程所在NUMA分区的页缓存上
+//  - 不加锁，同一个 Region 不能被多个线程同时使用
+class Region
+{
+public:
+    static const size_t MIN_REGION_PAGES = 4;
+
+    explicit Region(PageCache* pageCache = NumaPartitions::GetPageCache(NumaPartitions::CurrentNode()))
+        : _pageCache(pageCache)
+    {}
+
+    ~Region()
+    {
+        Reset();
+    }
+
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+
+    // alignment 必须是2的幂
+    void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        char* p = (char*)(((uintptr_t)_cur + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        if (p < _end && (size_t)(_end - p) >= bytes)
+        {
+            _cur = p + bytes;
+            return p;
+        }
+        return AllocateSlow(bytes, alignment);
+    }
+
+    // 所有span还给页缓存，之前分配出去的内存全部失效；块大小的增长进度保留，下次不必从小块重新长
+    void Reset();
+
+    // 当前持有的span合计字节数
+    size_t BytesReserved() const
+    {
+        return _reserved;
+    }
+
+private:
+    // 每个span的开头：串起本区域所有的span，Reset 时逐个归还
+    struct Chunk
+    {
+        Chunk* _prev;
+        Span* _span;
+    };
+
+    void* AllocateSlow(size_t bytes, size_t alignment);
+
+    PageCache* _pageCache;
+    char* _cur = nullptr;       // 当前块里下一个可分配的位置
+    char* _end = nullptr;
+    Chunk* _chunks = nullptr;   // 最近申请的span，顺着 _prev 找到全部
+    size_t _nextPages = MIN_REGION_PAGES;
+    size_t _reserved = 0;
+};
+
+#ifdef REGION_HAVE_PMR
+// std::pmr 接口：标准容器直接用 Region 分配，deallocate 什么都不做
+//   RegionResource res;
+//   std::pmr::vector<int> v(&res);
+class RegionResource : public std::pmr::memory_resource
+{
+public:
+    explicit RegionResource(PageCache* pageCache = NumaPartitions::GetPageCache(NumaPartitions::CurrentNode()))
+        : _region(pageCache)
+    {}
+
+    // 使用它的容器必须已经析构或不再访问
+    void Reset()
+    {
+        _region.Reset();
+    }
+
+    Region& GetRegion()
+    {
+        return _region;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        return _region.Allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override
+    {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    Region _region;
+};
+#endif
@@ -0,0 +1,78 @@
+#include"Scavenger.h"
+#include"ThreadCache.h"
+#include"CpuCache.h"
+#include"Numa.h"
+#include<condition_variable>
+
+static std::mutex scavengerMtx;
+static std::condition_variable scavengerCv;
+static std::thread* scavengerThread = nullptr;
+static size_t scavengerInterval = 0;
+static bool scavengerStop = false;
+
+// 按速度还页，每个分区每次最多还 rate * intervalMs 的量
+static void ReleasePageCaches(size_t intervalMs)
+{
+    size_t pages = (PageCache::GetReleaseRate() / 1000 * intervalMs) >> PAGE_SHIFT;
+    if (pages == 0)
+        return;
+    for (size_t node = 0; node < NumaPartitions::Count(); ++node)
+    {
+        // 中转缓存里的批次、分片里留着的span也算闲置，先还回页缓存
+        NumaPartitions::GetTransferCache(node)->Drain(NumaPartitions::GetCentralCache(node));
+        PageCache* pc = NumaPartitions::GetPageCache(node);
+        pc->FlushShards();
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        pc->ReleaseFreePages(pages);
+    }
+}
+
+static void ScavengerLoop()
+{
+    std::unique_lock<std::mutex> ul(scavengerMtx);
+    while (!scavengerStop)
+    {
+        scavengerCv.wait_for(ul, std::chrono::milliseconds(scavengerInterval));
+        if (scavengerStop)
+            break;
+
+        size_t interval = scavengerInterval;
+        ul.unlock();
+        ThreadCache::RequestScavenge();
+        CpuCache::ReleaseIdleAll();
+        ReleasePageCaches(interval);
+        ul.lock();
+    }
+}
+
+void StartScavenger(size_t intervalMs)
+{
+    std::lock_guard<std::mutex> lg(scavengerMtx);
+    scavengerInterval = intervalMs ? intervalMs : 1;
+    if (scavengerThread == nullptr)
+    {
+        scavengerStop = false;
+        for (size_t node = 0; node < NumaPartitions::Count(); ++node)
+            NumaPartitions::GetPageCache(node)->SetBackgroundRelease(true);
+        scavengerThread = new std::thread(ScavengerLoop);
+    }
+}
+
+void StopScavenger()
+{
+    std::thread* t = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(scavengerMtx);
+        scavengerStop = true;
+        t = scavengerThread;
+        scavengerThread = nullptr;
+    }
+    scavengerCv.notify_all();
+    if (t)
+    {
+        t->join();
+        delete t;
+        for (size_t node = 0; node < NumaPartitions::Count(); ++node)
+            NumaPartitions::GetPageCache(node)->SetBackgroundRelease(false);
+    }
+}
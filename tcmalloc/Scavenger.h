@@ -0,0 +1,14 @@
+#pragma once
+
+#include"Common.h"
+
+// 可选的后台回收线程，每隔 intervalMs 毫秒：
+//  1. 请求所有线程缓存在各自下一次释放时按低水位回收闲置对象
+//     （阻塞中的线程要等它再次运行；线程缓存的快路径不加锁，别的线程不能替它回收）
+//  2. 直接按低水位回收每CPU缓存的闲置对象
+//  3. 各分区中转缓存里的批次还给中心缓存，页缓存分片里留着的span还回页缓存，
+//     再按 PageCache::GetReleaseRate 的速度把空闲页还给系统，运行期间这些页缓存释放span时
+//     不再顺带还页(独立堆的页缓存不在其内，照常顺带还)
+// 重复调用 StartScavenger 只会调整间隔
+void StartScavenger(size_t intervalMs);
+void StopScavenger();
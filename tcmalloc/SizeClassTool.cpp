@@ -0,0 +1,131 @@
+#include"Common.h"
+#include<cstdio>
+#include<cstdlib>
+#include<vector>
+#include<algorithm>
+
+// 根据 ALLOC_HISTOGRAM 模式写出的直方图生成定制的尺寸类别表
+//
+// 用法: size_class_tool 直方图文件 [最多新增类别数] > SizeClassCustom.h
+//       make clean && make SIZE_CLASS_FILE=SizeClassCustom.h
+//
+// 在默认类别的基础上贪心地插入新类别：每次选能省下最多内碎片字节(次数 x 少向上取整的字节)
+// 的热点大小(按查表粒度对齐)作为新的类别边界，直到达到数量上限(默认32)或收益不足申请总字节的 0.1%
+
+struct HistEntry
+{
+	size_t _size;
+	size_t _count;
+};
+
+// 类别大小必须满足的查表粒度与最小对齐
+static size_t AlignToClassGranularity(size_t size)
+{
+	size_t align = size <= 8 ? 8 : size <= SMALL_CLASS_LIMIT ? MIN_ALIGN : 128;
+	return SizeClass::_RoundUp(size, align);
+}
+
+// 按给定类别表计算的内碎片浪费字节数
+static size_t WastedBytes(const std::vector<HistEntry>& hist, const std::vector<size_t>& classes)
+{
+	size_t waste = 0;
+	for (auto& e : hist)
+	{
+		size_t cls = *std::lower_bound(classes.begin(), classes.end(), e._size);
+		waste += (cls - e._size) * e._count;
+	}
+	return waste;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "用法: %s 直方图文件 [最多新增类别数]\n", argv[0]);
+		return 1;
+	}
+
+	FILE* fp = fopen(argv[1], "r");
+	if (fp == nullptr)
+	{
+		fprintf(stderr, "无法打开 %s\n", argv[1]);
+		return 1;
+	}
+	std::vector<HistEntry> hist;
+	size_t size = 0, count = 0;
+	while (fscanf(fp, "%zu %zu", &size, &count) == 2)
+	{
+		if (size > 0 && size <= MAX_BYTES && count > 0)
+			hist.push_back(HistEntry{ size, count });
+	}
+	fclose(fp);
+	std::sort(hist.begin(), hist.end(),
+		[](const HistEntry& a, const HistEntry& b) { return a._size < b._size; });
+
+	std::vector<size_t> classes;
+	SizeClassList base = GenerateDefaultSizeClasses();
+	for (size_t i = 0; i < base._count; ++i)
+		classes.push_back(base._classes[i]._size);
+
+	size_t maxExtra = 32;
+	if (argc > 2)
+		maxExtra = strtoul(argv[2], nullptr, 10);
+	maxExtra = std::min(maxExtra, 255 - classes.size());
+
+	// 前缀和：prefix[i] 为 hist[0, i) 的次数之和，用来 O(logN) 算候选的收益
+	std::vector<size_t> prefix(hist.size() + 1, 0);
+	for (size_t i = 0; i < hist.size(); ++i)
+		prefix[i + 1] = prefix[i] + hist[i]._count;
+
+	size_t requested = 0;
+	for (auto& e : hist)
+		requested += e._size * e._count;
+
+	size_t before = WastedBytes(hist, classes);
+	for (size_t added = 0; added < maxExtra; ++added)
+	{
+		size_t bestClass = 0, bestGain = 0;
+		for (auto& e : hist)
+		{
+			size_t cand = AlignToClassGranularity(e._size);
+			auto it = std::lower_bound(classes.begin(), classes.end(), cand);
+			if (*it == cand)
+				continue;
+
+			// (上一个类别, cand] 里的申请原本取整到 *it，现在只取整到 cand
+			size_t prev = it == classes.begin() ? 0 : *(it - 1);
+			auto lo = std::upper_bound(hist.begin(), hist.end(), prev,
+				[](size_t v, const HistEntry& h) { return v < h._size; });
+			auto hi = std::upper_bound(hist.begin(), hist.end(), cand,
+				[](size_t v, const HistEntry& h) { return v < h._size; });
+			size_t n = prefix[hi - hist.begin()] - prefix[lo - hist.begin()];
+			size_t gain = n * (*it - cand);
+			if (gain > bestGain)
+			{
+				bestGain = gain;
+				bestClass = cand;
+			}
+		}
+
+		if (bestGain == 0 || bestGain * 1000 < requested)
+			break;
+		classes.insert(std::lower_bound(classes.begin(), classes.end(), bestClass), bestClass);
+		fprintf(stderr, "新增类别 %zu 字节，少浪费 %zu 字节\n", bestClass, bestGain);
+	}
+	size_t after = WastedBytes(hist, classes);
+
+	fprintf(stderr, "类别数 %zu -> %zu，内碎片 %.2f%% -> %.2f%%\n",
+		(size_t)base._count, classes.size(),
+		requested ? 100.0 * before / requested : 0.0,
+		requested ? 100.0 * after / requested : 0.0);
+
+	printf("// 由 size_class_tool 根据 %s 生成，不要手工修改\n", argv[1]);
+	printf("// 重新编译: make clean && make SIZE_CLASS_FILE=<本文件>\n");
+	printf("#pragma once\n\n");
+	printf("static constexpr size_t CUSTOM_SIZE_CLASSES[] = {");
+	for (size_t i = 0; i < classes.size(); ++i)
+		printf("%s%zu%s", i % 12 == 0 ? "\n\t" : " ", classes[i], i + 1 < classes.size() ? "," : "");
+	printf("\n};\n");
+
+	return 0;
+}
@@ -1,6 +1,233 @@
 #include"ThreadCache.h"
 #include"CentralCache.h"
-thread_local ThreadCache* TlsThreadCache = nullptr;
+#include"TransferCache.h"
+#include"Numa.h"
+#include"ObjectPool.h"
+#include<pthread.h>
+#include<cstdlib>
+thread_local ThreadCache* TlsThreadCache TLS_INITIAL_EXEC = nullptr;
+
+std::atomic<size_t> ThreadCache::_scavengeEpoch(0);
+
+static ObjectPool<ThreadCache> tcpool;
+static pthread_key_t tcKey;
+
+// 以下登记表与预算状态都由 tcMtx 保护
+static std::mutex tcMtx;
+static ThreadCache* tcListHead = nullptr;
+static ThreadCache* tcNextSteal = nullptr;   // 下一个被偷取额度的线程缓存
+static size_t tcOverallBudget = THREAD_CACHE_BUDGET;
+static long long tcUnclaimed = THREAD_CACHE_BUDGET; // 尚未分给任何线程缓存的额度，可为负
+
+static void CreateThreadCacheKey() {
+    // 线程退出时，pthread 以登记的 ThreadCache 为参数调用 Destroy
+    pthread_key_create(&tcKey, ThreadCache::Destroy);
+
+    const char* env = getenv("TCMALLOC_THREAD_CACHE_BYTES");
+    if (env != nullptr)
+        ThreadCache::SetOverallBudget(strtoull(env, nullptr, 10));
+}
+
+ThreadCache::ThreadCache()
+    : _central(NumaPartitions::GetCentralCache(NumaPartitions::CurrentNode()))
+    , _transfer(NumaPartitions::GetTransferCache(NumaPartitions::CurrentNode()))
+{}
+
+ThreadCache* ThreadCache::Create() {
+    size_t node = NumaPartitions::CurrentNode();
+    ThreadCache* tc = Create(NumaPartitions::GetCentralCache(node), NumaPartitions::GetTransferCache(node));
+    pthread_setspecific(tcKey, tc);
+    return tc;
+}
+
+ThreadCache* ThreadCache::Create(CentralCache* central, TransferCache* transfer) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, CreateThreadCacheKey);
+
+    ThreadCache* tc = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(tcMtx);
+        tc = tcpool.New();
+        tc->_central = central;
+        tc->_transfer = transfer;
+
+        tc->_registered = true;
+        tc->_next = tcListHead;
+        if (tcListHead)
+            tcListHead->_prev = tc;
+        tcListHead = tc;
+
+        // 先从未分配额度里拿，拿不到就偷；实在分不到也给一个最小额度（额度透支）
+        tc->_maxSize.store(0, std::memory_order_relaxed);
+        tc->IncreaseCacheLimitLocked();
+        if (tc->_maxSize.load(std::memory_order_relaxed) == 0) {
+            tc->_maxSize.store(MIN_THREAD_CACHE, std::memory_order_relaxed);
+            tcUnclaimed -= MIN_THREAD_CACHE;
+        }
+    }
+    return tc;
+}
+
+void ThreadCache::Destroy(void* ptr) {
+    ThreadCache* tc = (ThreadCache*)ptr;
+    tc->ReleaseAll();
+
+    // 之后若还有其他线程退出钩子释放内存，会重新创建一个ThreadCache，
+    // pthread 会再调用一轮 Destroy 把它也回收掉
+    if (TlsThreadCache == tc)
+        TlsThreadCache = nullptr;
+
+    std::lock_guard<std::mutex> lg(tcMtx);
+    tc->UnregisterLocked();
+    tcpool.Delete(tc);
+}
+
+void ThreadCache::DiscardAll(CentralCache* central) {
+    std::lock_guard<std::mutex> lg(tcMtx);
+    ThreadCache* tc = tcListHead;
+    while (tc) {
+        ThreadCache* next = tc->_next;
+        if (tc->_central == central) {
+            tc->UnregisterLocked();
+            tcpool.Delete(tc);
+        }
+        tc = next;
+    }
+}
+
+void ThreadCache::UnregisterLocked() {
+    if (_prev)
+        _prev->_next = _next;
+    else
+        tcListHead = _next;
+    if (_next)
+        _next->_prev = _prev;
+    if (tcNextSteal == this)
+        tcNextSteal = _next;
+    tcUnclaimed += _maxSize.load(std::memory_order_relaxed);
+}
+
+void ThreadCache::SetOverallBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lg(tcMtx);
+
+    // 已分出去的上限按新旧预算的比例缩放，超出的部分由各线程下次释放时归还
+    double ratio = tcOverallBudget ? (double)bytes / tcOverallBudget : 1.0;
+    long long claimed = 0;
+    for (ThreadCache* tc = tcListHead; tc; tc = tc->_next) {
+        size_t maxSize = (size_t)(tc->_maxSize.load(std::memory_order_relaxed) * ratio);
+        maxSize = std::max(MIN_THREAD_CACHE, std::min(maxSize, MAX_THREAD_CACHE));
+        tc->_maxSize.store(maxSize, std::memory_order_relaxed);
+        claimed += maxSize;
+    }
+    tcOverallBudget = bytes;
+    tcUnclaimed = (long long)bytes - claimed;
+}
+
+size_t ThreadCache::TotalCachedBytes() {
+    std::lock_guard<std::mutex> lg(tcMtx);
+    size_t total = 0;
+    for (ThreadCache* tc = tcListHead; tc; tc = tc->_next)
+        total += tc->_size.load(std::memory_order_relaxed);
+    return total;
+}
+
+void ThreadCache::IncreaseCacheLimit() {
+    if (!_registered)
+        return;
+    std::lock_guard<std::mutex> lg(tcMtx);
+    IncreaseCacheLimitLocked();
+}
+
+void ThreadCache::IncreaseCacheLimitLocked() {
+    size_t maxSize = _maxSize.load(std::memory_order_relaxed);
+    if (maxSize >= MAX_THREAD_CACHE)
+        return;
+
+    if (tcUnclaimed > 0) {
+        size_t take = std::min((size_t)tcUnclaimed, THREAD_CACHE_STEAL);
+        tcUnclaimed -= take;
+        _maxSize.store(maxSize + take, std::memory_order_relaxed);
+        return;
+    }
+
+    // 没有剩余额度，轮流从其他线程缓存偷它们闲置(未被占用)的那部分上限，
+    // 这样被偷者持有的字节数不会超过新的上限，合计持有量始终受预算约束
+    const int kMaxTries = 10;
+    for (int i = 0; i < kMaxTries; ++i) {
+        if (tcNextSteal == nullptr)
+            tcNextSteal = tcListHead;
+        ThreadCache* victim = tcNextSteal;
+        tcNextSteal = victim->_next;
+        if (victim == this)
+            continue;
+
+        size_t victimMax = victim->_maxSize.load(std::memory_order_relaxed);
+        if (victimMax < MIN_THREAD_CACHE + THREAD_CACHE_STEAL)
+            continue;
+        if (victim->_size.load(std::memory_order_relaxed) + THREAD_CACHE_STEAL > victimMax)
+            continue;
+
+        victim->_maxSize.store(victimMax - THREAD_CACHE_STEAL, std::memory_order_relaxed);
+        _maxSize.store(maxSize + THREAD_CACHE_STEAL, std::memory_order_relaxed);
+        return;
+    }
+}
+
+void ThreadCache::ReleaseAll() {
+    for (size_t i = 0; i < NFREELIST; ++i) {
+        FreeList& list = _freeList[i];
+        if (list.Empty())
+            continue;
+
+        void* start = nullptr;
+        void* end = nullptr;
+        list.PopRange(start, end, list.Size());
+        _central->ReleaseListToSpans(start, SizeClass::ClassSize(i));
+    }
+    _size.store(0, std::memory_order_relaxed);
+}
+
+void ThreadCache::ReleaseIdle() {
+    for (size_t i = 0; i < NFREELIST; ++i) {
+        FreeList& list = _freeList[i];
+        size_t lowWater = list.LowWater();
+        if (lowWater > 0) {
+            // 只还一半：区间内的低谷不代表以后都用不到
+            size_t n = (lowWater + 1) / 2;
+            size_t size = SizeClass::ClassSize(i);
+            void* start = nullptr;
+            void* end = nullptr;
+            list.PopRange(start, end, n);
+            SubSize(n * size);
+            _central->ReleaseListToSpans(start, size);
+        }
+        list.ResetLowWater();
+    }
+
+    _opsUntilScavenge = SCAVENGE_INTERVAL;
+    _seenEpoch = _scavengeEpoch.load(std::memory_order_relaxed);
+}
+
+void ThreadCache::Scavenge() {
+    ReleaseIdle();
+
+    for (size_t i = 0; i < NFREELIST && CachedBytes() > _maxSize.load(std::memory_order_relaxed); ++i) {
+        FreeList& list = _freeList[i];
+        if (list.Empty())
+            continue;
+
+        size_t n = (list.Size() + 1) / 2;
+        size_t size = SizeClass::ClassSize(i);
+        void* start = nullptr;
+        void* end = nullptr;
+        list.PopRange(start, end, n);
+        SubSize(n * size);
+        _central->ReleaseListToSpans(start, size);
+        list.ResetLowWater();
+    }
+
+    IncreaseCacheLimit();
+}
 
 //申请内存
 void* ThreadCache::Allocate(size_t size) {
@@ -9,6 +236,7 @@ void* ThreadCache::Allocate(size_t size) {
     size_t pos = SizeClass::Index(size);
     size_t alignsize = SizeClass::RoundUp(size);
     if (!_freeList[pos].Empty()) {
+        SubSize(alignsize);
         return _freeList[pos].Pop();
     }
     else { 
@@ -28,7 +256,10 @@ void* ThreadCache::FetchFromCentralCache(size_t index,size_t size) {
     //申请一段内存
     void* start = nullptr;
     void* end = nullptr;
-    size_t n = CentralCache::GetInstance()->FetchRangeObj(start,end,batchNum,size);
+    //先从中转缓存整批拿，没有再去中心缓存切
+    size_t n = _transfer->RemoveRange(index,start,end,batchNum);
+    if (n == 0)
+        n = _central->FetchRangeObj(start,end,batchNum,size);
     if (n == 0) {
         // 可选：对 MaxSize 做一次温和退让，避免在压力下无限增大（若之前增长过）
         if (cur_max > 1) {
@@ -42,6 +273,7 @@ void* ThreadCache::FetchFromCentralCache(size_t index,size_t size) {
     }
 
     _freeList[index].PushRange(NextObj(start),end,n - 1);
+    AddSize((n - 1) * size);
     if (n == batchNum && cur_max < max_move) {
         _freeList[index].SetMaxSize(std::min(cur_max + 1,max_move));
     }
@@ -60,23 +292,95 @@ void ThreadCache::Deallocate(void* p,size_t size)
     assert(size <= MAX_BYTES);
 
     size_t pos = SizeClass::Index(size);
+    size_t alignsize = SizeClass::RoundUp(size);
 
     _freeList[pos].Push(p);
+    AddSize(alignsize);
     
     if(_freeList[pos].Size() >= _freeList[pos].MaxSize())
     {
-        ListTooLong(_freeList[pos],size);
+        ListTooLong(_freeList[pos],alignsize);
+    }
+
+    //整个线程缓存超出字节预算
+    if(_size.load(std::memory_order_relaxed) > _maxSize.load(std::memory_order_relaxed))
+    {
+        Scavenge();
+    }
+    //释放次数攒够了，或后台回收线程发来了请求
+    else if(--_opsUntilScavenge == 0 || _seenEpoch != _scavengeEpoch.load(std::memory_order_relaxed))
+    {
+        ReleaseIdle();
+    }
+}
+
+
+void ThreadCache::AllocateBatch(size_t size, size_t n, void** out)
+{
+    assert(size <= MAX_BYTES);
+
+    size_t index = SizeClass::Index(size);
+    size_t alignsize = SizeClass::RoundUp(size);
+    FreeList& list = _freeList[index];
+
+    //自由链表里现有的一次取完，只遍历一遍
+    size_t got = 0;
+    size_t k = std::min(n, list.Size());
+    while (got < k)
+        out[got++] = list.Pop();
+    SubSize(k * alignsize);
+
+    //剩下的不经过自由链表，按一批的上限直接向中转缓存/中心缓存要
+    const size_t maxMove = SizeClass::NumMoveSize(alignsize);
+    while (got < n) {
+        size_t want = std::min(n - got, maxMove);
+        void* start = nullptr;
+        void* end = nullptr;
+        size_t m = _transfer->RemoveRange(index, start, end, want);
+        if (m == 0)
+            m = _central->FetchRangeObj(start, end, want, alignsize);
+        void* p = start;
+        for (size_t i = 0; i < m; ++i) {
+            out[got++] = p;
+            p = NextObj(p);
+        }
     }
 }
 
+void ThreadCache::DeallocateRange(size_t index, void* start, size_t n)
+{
+    FreeList& list = _freeList[index];
+    size_t size = SizeClass::ClassSize(index);
+
+    //自由链表最多留到MaxSize个，多出来的整段一次还给中心缓存
+    size_t keep = list.Size() < list.MaxSize() ? std::min(n, list.MaxSize() - list.Size()) : 0;
+    if (keep > 0) {
+        void* keepEnd = start;
+        for (size_t i = 1; i < keep; ++i)
+            keepEnd = NextObj(keepEnd);
+        void* rest = NextObj(keepEnd);
+        list.PushRange(start, keepEnd, keep);
+        AddSize(keep * size);
+        start = rest;
+    }
+    if (keep < n)
+        _central->ReleaseListToSpans(start, size);
+
+    if (_size.load(std::memory_order_relaxed) > _maxSize.load(std::memory_order_relaxed))
+        Scavenge();
+}
 
 //将当前链表过长的内存归还给中心缓存
 void ThreadCache::ListTooLong(FreeList& list,size_t size)
 {
     void* start = nullptr;
     void* end = nullptr;
-    list.PopRange(start,end,list.MaxSize());
-    CentralCache::GetInstance()->ReleaseListToSpans(start,size);
+    size_t n = list.MaxSize();
+    list.PopRange(start,end,n);
+    SubSize(n * size);
+    //整批交给中转缓存，满了才拆开还给各自的span
+    if (!_transfer->InsertRange(SizeClass::Index(size),start,end,n))
+        _central->ReleaseListToSpans(start,size);
 }
 
 
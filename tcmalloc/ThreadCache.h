@@ -2,20 +2,108 @@
 
 #include"Common.h"
 
+class CentralCache;
+class TransferCache;
+
 class ThreadCache
 {
 public:
+    //默认从当前线程所在NUMA分区的中转缓存/中心缓存补货(单节点时即全局的)
+    ThreadCache();
+
     void* Allocate(size_t size);
     void Deallocate(void* p,size_t size);
+
+    //批量申请n个同样大小的对象写入out：先取完自由链表里现有的，不够的整批直接向下层要
+    void AllocateBatch(size_t size, size_t n, void** out);
+
+    //批量释放同一尺寸类别、已串成以nullptr结尾链表的n个对象
+    void DeallocateRange(size_t index, void* start, size_t n);
     //从中心缓存获取对象
     void* FetchFromCentralCache(size_t index,size_t size);
 
     //释放对象时,链表过长时，回收内存回到中心缓存
 	void ListTooLong(FreeList& list, size_t size);
 
+    //把所有自由链表上的对象归还中心缓存
+    void ReleaseAll();
+
+    //按低水位回收：上次回收以来一直没被用到的对象，归还其中一半给中心缓存
+    void ReleaseIdle();
+
+    //补货/归还的中心缓存，NUMA 模式下释放时据此判断对象是否属于本缓存的分区
+    CentralCache* GetCentralCache() const {
+        return _central;
+    }
+
+    //当前缓存的字节数
+    size_t CachedBytes() const {
+        return _size.load(std::memory_order_relaxed);
+    }
+
+    //为当前线程创建ThreadCache(绑定当前所在的NUMA分区)，并登记线程退出时的回收钩子
+    static ThreadCache* Create();
+
+    //创建一个从指定中转缓存/中心缓存补货的ThreadCache(Heap 实例用)，登记进预算，
+    //不登记线程退出钩子，由调用者在线程退出时调用 Destroy
+    static ThreadCache* Create(CentralCache* central, TransferCache* transfer);
+
+    //丢弃所有从central补货的ThreadCache，缓存的对象不归还：销毁堆时它们所在的页整体还给系统
+    static void DiscardAll(CentralCache* central);
+
+    //线程退出时调用：归还缓存的对象，ThreadCache对象回收给下一个线程复用
+    static void Destroy(void* tc);
+
+    //调整所有线程缓存合计的字节预算
+    static void SetOverallBudget(size_t bytes);
+
+    //所有登记在册的线程缓存当前合计持有的字节数
+    static size_t TotalCachedBytes();
+
+    //请求所有线程缓存在各自下一次释放时做一次闲置回收（后台回收线程调用）
+    static void RequestScavenge() {
+        _scavengeEpoch.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    //缓存字节数超过上限：先回收闲置对象，仍超出则每条链表归还一半，再尝试提高上限
+    void Scavenge();
+
+    //从未分配额度或其他线程缓存那里争取 THREAD_CACHE_STEAL 字节的上限
+    void IncreaseCacheLimit();
+    void IncreaseCacheLimitLocked();
+
+    //从登记表摘下，额度还给未分配部分；调用者持有登记表的锁
+    void UnregisterLocked();
+
+    void AddSize(size_t bytes) {
+        _size.store(_size.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    }
+    void SubSize(size_t bytes) {
+        _size.store(_size.load(std::memory_order_relaxed) - bytes, std::memory_order_relaxed);
+    }
+
 private:
     FreeList _freeList[NFREELIST];
+
+    // 补货/归还的下一层
+    CentralCache* _central;
+    TransferCache* _transfer;
+
+    // 当前缓存的字节数只由所属线程修改；上限可能被其他线程偷走，两者都可被其他线程读取
+    std::atomic<size_t> _size{0};
+    std::atomic<size_t> _maxSize{MAX_THREAD_CACHE};
+
+    // 距下一次闲置回收还剩的释放次数，以及已响应过的回收请求编号
+    size_t _opsUntilScavenge = SCAVENGE_INTERVAL;
+    size_t _seenEpoch = 0;
+    static std::atomic<size_t> _scavengeEpoch;
+
+    // 登记表：所有线程的ThreadCache串成双向链表，偷取额度时轮流挑选
+    bool _registered = false;
+    ThreadCache* _next = nullptr;
+    ThreadCache* _prev = nullptr;
 };
 
 //线程本地存储声明（在 ThreadCache.cpp 中定义）
-extern thread_local ThreadCache* TlsThreadCache;
\ No newline at end of file
+extern thread_local ThreadCache* TlsThreadCache TLS_INITIAL_EXEC;
@@ -0,0 +1,90 @@
+#include"TransferCache.h"
+#include"CentralCache.h"
+#include<cstdlib>
+
+const size_t TransferCache::MAX_SLOTS;
+const size_t TransferCache::MAX_BYTES_PER_CLASS;
+
+// 环境变量 TCMALLOC_TRANSFER_CACHE=0 关闭中转缓存(所有批次直接走CentralCache)，用于对比
+TransferCache::TransferCache()
+{
+    const char* env = getenv("TCMALLOC_TRANSFER_CACHE");
+    _disabled = env != nullptr && strcmp(env, "0") == 0;
+
+    for (size_t i = 0; i < NFREELIST; ++i)
+    {
+        size_t size = SizeClass::ClassSize(i);
+        size_t batchBytes = SizeClass::NumMoveSize(size) * size;
+        size_t slots = MAX_BYTES_PER_CLASS / batchBytes;
+        _lists[i]._capacity = _disabled ? 0 : std::max((size_t)1, std::min(slots, MAX_SLOTS));
+    }
+}
+
+bool TransferCache::InsertRange(size_t index, void* start, void* end, size_t n)
+{
+    ClassList& list = _lists[index];
+    // 超过一批上限的不收，否则压在栈顶谁也取不走
+    if (n > SizeClass::NumMoveSize(SizeClass::ClassSize(index)))
+        return false;
+
+    std::lock_guard<std::mutex> lg(list._mtx);
+    if (list._used == list._capacity)
+        return false;
+
+    list._slots[list._used++] = Batch{ start, end, n };
+    return true;
+}
+
+size_t TransferCache::RemoveRange(size_t index, void*& start, void*& end, size_t batchNum)
+{
+    ClassList& list = _lists[index];
+    std::lock_guard<std::mutex> lg(list._mtx);
+    // 只看最近放入的一批(大概率还在CPU缓存里)；比要的多就不拆，交给CentralCache
+    if (list._used == 0 || list._slots[list._used - 1]._n > batchNum)
+        return 0;
+
+    Batch& b = list._slots[--list._used];
+    start = b._start;
+    end = b._end;
+    return b._n;
+}
+
+size_t TransferCache::CachedBytes()
+{
+    size_t total = 0;
+    for (size_t i = 0; i < NFREELIST; ++i)
+    {
+        std::lock_guard<std::mutex> lg(_lists[i]._mtx);
+        for (size_t j = 0; j < _lists[i]._used; ++j)
+            total += _lists[i]._slots[j]._n * SizeClass::ClassSize(i);
+    }
+    return total;
+}
+
+size_t TransferCache::Drain(CentralCache* central)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < NFREELIST; ++i)
+    {
+        // 持类别锁只把各批首尾相接串成一条，拆开还span在锁外做
+        void* start = nullptr;
+        size_t n = 0;
+        {
+            std::lock_guard<std::mutex> lg(_lists[i]._mtx);
+            for (size_t j = 0; j < _lists[i]._used; ++j)
+            {
+                Batch& b = _lists[i]._slots[j];
+                NextObj(b._end) = start;
+                start = b._start;
+                n += b._n;
+            }
+            _lists[i]._used = 0;
+        }
+        if (start == nullptr)
+            continue;
+        size_t size = SizeClass::ClassSize(i);
+        central->ReleaseListToSpans(start, size);
+        total += n * size;
+    }
+    return total;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include"Common.h"
+#include<new>
+
+class CentralCache;
+
+// 每个尺寸类别一份的中转缓存，位于ThreadCache与CentralCache之间
+// 线程缓存还回的一批对象整体(头、尾、个数)存进来，不拆开、不碰Span；
+// 别的线程补货时直接整批拿走。只有中转缓存满了(放入)或空了(取出)才落到CentralCache，
+// 这样生产者线程释放、消费者线程申请的场景基本不需要按span重新分组。
+class TransferCache
+{
+public:
+    static const size_t MAX_SLOTS = 64;                 // 每个类别最多存几批
+    static const size_t MAX_BYTES_PER_CLASS = 1 << 20; // 每个类别最多囤积的字节数
+
+    static TransferCache* GetInstance();
+
+    // 放入一批n个对象(start..end已串好)，满了返回false，调用者改还给CentralCache
+    bool InsertRange(size_t index, void* start, void* end, size_t n);
+
+    // 取出一整批，个数不超过batchNum；没有合适的批次返回0，调用者改向CentralCache申请
+    size_t RemoveRange(size_t index, void*& start, void*& end, size_t batchNum);
+
+    // 当前合计囤积的字节数
+    size_t CachedBytes();
+
+    // 把所有类别囤积的批次都拆开还给 central 的span，返回还了多少字节。
+    // 只有别的线程补货时才会取走批次，清理线程和显式还内存时靠它让空出来的span回到页缓存
+    size_t Drain(CentralCache* central);
+
+private:
+    struct Batch
+    {
+        void* _start;
+        void* _end;
+        size_t _n;
+    };
+
+    // 各类别独占缓存行，互不干扰
+    struct alignas(64) ClassList
+    {
+        std::mutex _mtx;
+        size_t _used = 0;
+        size_t _capacity = 0;
+        Batch _slots[MAX_SLOTS];
+    };
+
+    ClassList _lists[NFREELIST];
+    bool _disabled = false;
+
+private:
+    friend class Heap;
+    friend class NumaPartitions;
+    TransferCache(const TransferCache&) = delete;
+    TransferCache();
+};
+
+// 同 CentralCache::GetInstance，首次使用时构造且永不析构
+inline TransferCache* TransferCache::GetInstance() {
+    alignas(TransferCache) static char storage[sizeof(TransferCache)];
+    static TransferCache* inst = new (storage) TransferCache;
+    return inst;
+}
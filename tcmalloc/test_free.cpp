@@ -1,7 +1,11 @@
 #include"ConcurrentAlloc.h"
+#include"TransferCache.h"
 #include<vector>
 #include<thread>
 #include<chrono>
+#include<sys/wait.h>
+#include<sys/stat.h>
+#include<cerrno>
 
 // 测试基本的申请和释放
 void TestBasicAllocFree()
@@ -353,8 +357,1327 @@ void TestEdgeCases()
     cout << endl;
 }
 
-int main()
+// 测试带大小的释放与全局 operator new/delete
+void TestSizedFree()
 {
+    cout << "=== 测试带大小的释放 ===" << endl;
+
+    std::vector<size_t> sizes = {1, 8, 24, 100, 129, 1000, 1025, 8*1024 + 1, 64*1024 + 1, MAX_BYTES, MAX_BYTES + 1};
+    for(auto size : sizes)
+    {
+        void* ptr = ConcurrentAlloc(size);
+        memset(ptr, 0x5A, size);
+        ConcurrentFree(ptr, size);
+    }
+    cout << "按申请大小释放 " << sizes.size() << " 个内存块成功" << endl;
+
+    // 链接 NewDelete.cpp 后，下面的 new/delete 走内存池，delete 带大小
+    struct Node { Node* left; Node* right; int val; };
+    std::vector<Node*> nodes;
+    for(int i = 0; i < 1000; ++i)
+    {
+        nodes.push_back(new Node{nullptr, nullptr, i});
+    }
+    for(auto node : nodes)
+    {
+        delete node;
+    }
+    int* arr = new int[300];
+    delete[] arr;
+    cout << "operator new/delete 申请释放成功" << endl;
+    cout << endl;
+}
+
+// 测试线程缓存字节预算：多个线程各自释放大量对象后停住，合计持有量不应超出预算太多
+void TestThreadCacheBudget()
+{
+    cout << "=== 测试线程缓存字节预算 ===" << endl;
+
+    const size_t budget = 2 * 1024 * 1024;
+    const int threadCount = 8;
+    ThreadCache::SetOverallBudget(budget);
+    // 主线程的上限被按比例缩小，释放一次让它归还多余对象
+    ConcurrentFree(ConcurrentAlloc(64));
+
+    std::atomic<int> done(0);
+    std::atomic<bool> quit(false);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&]() {
+            std::vector<void*> ptrs;
+            for(int i = 0; i < 2000; ++i)
+            {
+                ptrs.push_back(ConcurrentAlloc(i % 64 * 64 + 64));
+            }
+            for(auto ptr : ptrs)
+            {
+                ConcurrentFree(ptr);
+            }
+            ++done;
+            while(!quit)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+    while(done != threadCount)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    size_t cached = ThreadCache::TotalCachedBytes();
+    cout << "预算 " << budget << " 字节, 线程缓存合计持有 " << cached << " 字节" << endl;
+    assert(cached <= budget + (threadCount + 1) * MIN_THREAD_CACHE);
+
+    quit = true;
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    ThreadCache::SetOverallBudget(THREAD_CACHE_BUDGET);
+    cout << endl;
+}
+
+// 测试跨线程释放：一个线程申请，另一个线程释放，整批对象经中转缓存回到申请线程
+void TestCrossThreadFree()
+{
+    cout << "=== 测试跨线程释放(中转缓存) ===" << endl;
+
+    const size_t count = 20000;
+    const size_t size = 128;
+    for(int round = 0; round < 5; ++round)
+    {
+        std::vector<void*> ptrs(count);
+        std::thread producer([&]() {
+            for(size_t i = 0; i < count; ++i)
+            {
+                ptrs[i] = ConcurrentAlloc(size);
+                memset(ptrs[i], round, size);
+            }
+        });
+        producer.join();
+
+        std::thread consumer([&]() {
+            for(size_t i = 0; i < count; ++i)
+            {
+                assert(((unsigned char*)ptrs[i])[size - 1] == (unsigned char)round);
+                ConcurrentFree(ptrs[i]);
+            }
+        });
+        consumer.join();
+    }
+
+    size_t cached = TransferCache::GetInstance()->CachedBytes();
+    cout << "中转缓存合计持有 " << cached << " 字节" << endl;
+    assert(cached <= NFREELIST * TransferCache::MAX_BYTES_PER_CLASS);
+
+    // 显式还内存时囤积的批次都还给中心缓存
+    ConcurrentReleaseFreeMemory();
+    assert(TransferCache::GetInstance()->CachedBytes() == 0);
+    cout << endl;
+}
+
+// 测试批量接口：批量申请的对象互不重叠，混合大小(含大对象)可以一次批量释放
+void TestBatchApi()
+{
+    cout << "=== 测试批量申请/释放接口 ===" << endl;
+
+    const size_t n = 100000;
+    std::vector<void*> ptrs(n);
+    ConcurrentAllocBatch(48, n, ptrs.data());
+    for(size_t i = 0; i < n; ++i)
+    {
+        assert(ptrs[i] != nullptr);
+        memset(ptrs[i], (int)(i & 0xff), 48);
+    }
+    for(size_t i = 0; i < n; ++i)
+    {
+        assert(((unsigned char*)ptrs[i])[47] == (unsigned char)(i & 0xff));
+    }
+    ConcurrentFreeBatch(ptrs.data(), n);
+
+    // 不同大小混在一起释放
+    std::vector<void*> mixed;
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        mixed.push_back(ConcurrentAlloc(i % 7 == 0 ? MAX_BYTES + 4096 : i * 37 % 4096 + 1));
+    }
+    ConcurrentFreeBatch(mixed.data(), mixed.size());
+
+    // 释放掉的对象应当能被重新申请到
+    ConcurrentAllocBatch(48, n, ptrs.data());
+    ConcurrentFreeBatch(ptrs.data(), n);
+    cout << "批量申请/释放 " << n << " 个对象完成" << endl;
+    cout << endl;
+}
+
+// 测试对齐申请：各种对齐与大小组合都满足对齐，16字节及以上的普通申请至少16字节对齐
+void TestAlignedAlloc()
+{
+    cout << "=== 测试对齐申请 ===" << endl;
+
+    const size_t aligns[] = { 8, 16, 32, 64, 256, 4096, 8192, 64 * 1024, 1024 * 1024 };
+    const size_t sizes[] = { 1, 24, 100, 1000, 5000, 64 * 1024, MAX_BYTES, MAX_BYTES + 1 };
+    std::vector<void*> ptrs;
+    for(size_t align : aligns)
+    {
+        for(size_t size : sizes)
+        {
+            void* p = ConcurrentAlignedAlloc(align, size);
+            assert(p != nullptr);
+            assert((uintptr_t)p % align == 0);
+            memset(p, 0x5a, size);
+            ptrs.push_back(p);
+        }
+    }
+    for(void* p : ptrs)
+    {
+        ConcurrentFree(p);
+    }
+
+    assert(ConcurrentAlignedAlloc(24, 100) == nullptr);
+
+    // mmap 失败抛 bad_alloc 时不持页缓存锁，之后照常申请
+    for(size_t align : { (size_t)8192, (size_t)1 << 22 })
+    {
+        bool thrown = false;
+        try
+        {
+            ConcurrentAlignedAlloc(align, (size_t)1 << 47);
+        }
+        catch(const std::bad_alloc&)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        void* p = ConcurrentAlignedAlloc(align, MAX_BYTES + 1);
+        assert((uintptr_t)p % align == 0);
+        ConcurrentFree(p);
+    }
+
+    for(size_t size = 16; size <= 4096; size += 8)
+    {
+        void* p = ConcurrentAlloc(size);
+        assert((uintptr_t)p % 16 == 0);
+        ConcurrentFree(p);
+    }
+    cout << "对齐申请 " << ptrs.size() << " 次均满足对齐" << endl;
+    cout << endl;
+}
+
+static Span* MapObjToSpanGlobal(void* p)
+{
+    size_t node;
+    return NumaPartitions::MapObjToSpan(p, node);
+}
+
+// 测试realloc：同一类别内不换地址，页级span原地缩小/扩大，超大块mremap，内容始终保留
+void TestRealloc()
+{
+    cout << "=== 测试realloc ===" << endl;
+
+    // 同类别内原样返回
+    void* p = ConcurrentAlloc(100);
+    assert(ConcurrentRealloc(p, SizeClass::RoundUp(100)) == p);
+
+    // 从小对象一路增长到超大块再缩回来，前缀内容不变
+    size_t size = 100;
+    memset(p, 0x11, size);
+    for(size_t newSize = 200; newSize <= 8 * 1024 * 1024; newSize *= 3)
+    {
+        p = ConcurrentRealloc(p, newSize);
+        for(size_t i = 0; i < size; i += 97)
+        {
+            assert(((unsigned char*)p)[i] == 0x11);
+        }
+        memset(p, 0x11, newSize);
+        size = newSize;
+    }
+    for(size_t newSize = size / 2; newSize >= 64; newSize /= 5)
+    {
+        p = ConcurrentRealloc(p, newSize);
+        assert(((unsigned char*)p)[newSize - 1] == 0x11);
+    }
+    ConcurrentFree(p);
+
+    // 页级span缩小就地完成，后面空出来的页可以再原地长回去
+    p = ConcurrentAlloc(MAX_BYTES + 64 * 1024);
+    void* q = ConcurrentRealloc(p, MAX_BYTES + 4096);
+    assert(q == p);
+    q = ConcurrentRealloc(q, MAX_BYTES + 32 * 1024);
+    assert(q == p);
+    ConcurrentFree(q);
+
+    // 跨类别不原样返回；realloc 之后带新大小释放落在正确的类别/页级span上
+    p = ConcurrentAlloc(1024);
+    q = ConcurrentRealloc(p, 600);
+    assert(q != p && MapObjToSpanGlobal(q)->_objSize == SizeClass::RoundUp(600));
+    ConcurrentFree(q, 600);
+    srand(13);
+    for(int round = 0; round < 2000; ++round)
+    {
+        size_t cur = rand() % (2 * MAX_BYTES) + 1;
+        p = ConcurrentAlloc(cur);
+        for(int i = 0; i < 4; ++i)
+        {
+            cur = rand() % 3 == 0 ? rand() % (2 * MAX_BYTES) + 1 : rand() % 4096 + 1;
+            p = ConcurrentRealloc(p, cur);
+            memset(p, i, cur);
+        }
+        Span* span = MapObjToSpanGlobal(p);
+        if(cur <= MAX_BYTES)
+            assert(!span->_isPageSpan && span->_objSize == SizeClass::RoundUp(cur));
+        else
+            assert(span->_isPageSpan);
+        ConcurrentFree(p, cur);
+    }
+
+    // 空指针/0字节
+    p = ConcurrentRealloc(nullptr, 10);
+    assert(p != nullptr);
+    assert(ConcurrentRealloc(p, 0) == nullptr);
+    cout << "realloc 测试通过" << endl;
+    cout << endl;
+}
+
+inline bool AllZero(const void* p, size_t n)
+{
+    const unsigned char* c = (const unsigned char*)p;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(c[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+void TestCalloc()
+{
+    cout << "=== 测试calloc ===" << endl;
+
+    // 小对象、页级span、超大块：先写脏再释放，再次calloc必须是全0
+    const size_t sizes[] = { 24, 1000, MAX_BYTES + 4096, 8 * 1024 * 1024, 20 * 1024 * 1024 };
+    for(size_t size : sizes)
+    {
+        for(int round = 0; round < 3; ++round)
+        {
+            void* p = ConcurrentCalloc(1, size);
+            assert(p != nullptr);
+            assert(AllZero(p, size));
+            memset(p, 0xCD, size);
+            ConcurrentFree(p);
+        }
+    }
+
+    // 脏的页级span与新页合并后再切出来，也必须清零
+    void* a = ConcurrentAlloc(MAX_BYTES + 64 * 1024);
+    memset(a, 0xEF, MAX_BYTES + 64 * 1024);
+    ConcurrentFree(a);
+    void* b = ConcurrentCalloc(4, (MAX_BYTES + 128 * 1024) / 4);
+    assert(AllZero(b, MAX_BYTES + 128 * 1024));
+    ConcurrentFree(b);
+
+    // num * size 溢出
+    assert(ConcurrentCalloc((size_t)-1, 16) == nullptr);
+    assert(ConcurrentCalloc(((size_t)1 << 33), ((size_t)1 << 33)) == nullptr);
+    cout << "calloc 测试通过" << endl;
+    cout << endl;
+}
+
+void TestUsableSize()
+{
+    cout << "=== 测试可用大小 ===" << endl;
+
+    const size_t sizes[] = { 1, 8, 100, 1000, 5000, MAX_BYTES, MAX_BYTES + 1, 9 * 1024 * 1024 + 3 };
+    for(size_t size : sizes)
+    {
+        SizedPtr r = ConcurrentAllocAtLeast(size);
+        assert(r._ptr != nullptr);
+        assert(r._size >= size);
+        // 超过 NPAGES-1 页的大对象在透明大页模式下取整到整大页
+        size_t expect = SizeClass::RoundUp(size);
+        if(PageCache::GetInstance()->HugePageMode() && (expect >> PAGE_SHIFT) > NPAGES - 1)
+            expect = SizeClass::_RoundUp(expect, (size_t)1 << HUGE_PAGE_SHIFT);
+        assert(r._size == expect);
+        assert(ConcurrentUsableSize(r._ptr) == r._size);
+        // 返回的整块都能写
+        memset(r._ptr, 0x5A, r._size);
+        ConcurrentFree(r._ptr, r._size);
+    }
+    assert(ConcurrentUsableSize(nullptr) == 0);
+
+    // 对齐申请落在更大的类别里，可用大小按实际类别算
+    void* p = ConcurrentAlignedAlloc(64, 100);
+    assert(ConcurrentUsableSize(p) >= 100);
+    ConcurrentFree(p);
+
+    // realloc 保留调用者写到可用大小末尾的内容
+    SizedPtr r = ConcurrentAllocAtLeast(MAX_BYTES + 100);
+    memset(r._ptr, 0x77, r._size);
+    void* q = ConcurrentRealloc(r._ptr, r._size * 4);
+    assert(((unsigned char*)q)[r._size - 1] == 0x77);
+    assert(ConcurrentUsableSize(q) >= r._size * 4);
+    ConcurrentFree(q);
+    cout << "可用大小测试通过" << endl;
+    cout << endl;
+}
+
+// p 所在的页是否有映射：msync 对没有映射的地址返回 ENOMEM
+static bool IsMapped(const void* p)
+{
+    uintptr_t page = (uintptr_t)p & ~((uintptr_t)sysconf(_SC_PAGESIZE) - 1);
+    return msync((void*)page, 1, MS_ASYNC) == 0 || errno != ENOMEM;
+}
+
+// 进程虚拟地址空间大小(字节)
+static size_t GetVmSize()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if(fp == nullptr)
+        return 0;
+    unsigned long vsz = 0;
+    if(fscanf(fp, "%lu", &vsz) != 1)
+        vsz = 0;
+    fclose(fp);
+    return (size_t)vsz * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+void TestHeap()
+{
+    cout << "=== 测试独立堆 ===" << endl;
+
+    Heap* h1 = Heap::Create();
+    Heap* h2 = Heap::Create();
+    assert(h1 != nullptr && h2 != nullptr);
+
+    // 各自的页号映射只认自己的内存
+    const size_t sizes[] = { 8, 100, 4000, MAX_BYTES, MAX_BYTES + 1, 2 * 1024 * 1024 };
+    std::vector<void*> live;
+    for(size_t size : sizes)
+    {
+        void* a = ConcurrentAlloc(h1, size);
+        void* b = ConcurrentAlloc(h2, size);
+        memset(a, 0x11, size);
+        memset(b, 0x22, size);
+        assert(h1->GetPageCache()->MapObjToSpan(a) != nullptr);
+        assert(h2->GetPageCache()->MapObjToSpan(b) != nullptr);
+        assert(((unsigned char*)a)[size - 1] == 0x11);
+        ConcurrentFree(h1, a);
+        live.push_back(b);
+    }
+
+    // 多个线程在同一个堆上申请释放，线程退出时缓存还给这个堆
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([h1]() {
+            std::vector<void*> v;
+            for(size_t i = 0; i < 20000; ++i)
+                v.push_back(ConcurrentAlloc(h1, i % 1024 + 1));
+            for(size_t i = 0; i < v.size(); i += 2)
+                ConcurrentFree(h1, v[i]);
+        });
+    }
+    for(auto& t : threads)
+        t.join();
+
+    // 线程在堆销毁之后才退出：它的线程缓存已被丢弃，退出时不能再碰
+    std::atomic<int> stage(0);
+    std::thread late([h2, &stage]() {
+        for(size_t i = 0; i < 1000; ++i)
+            ConcurrentAlloc(h2, 64);
+        stage = 1;
+        while(stage != 2)
+            std::this_thread::yield();
+    });
+    while(stage != 1)
+        std::this_thread::yield();
+
+    // 带着存活对象直接销毁
+    Heap::Destroy(h1);
+    Heap::Destroy(h2);
+    stage = 2;
+    late.join();
+
+    // 反复创建销毁，次数超过槽位数，内存整体还给系统
+    size_t vmBefore = GetVmSize();
+    for(int round = 0; round < 300; ++round)
+    {
+        Heap* h = Heap::Create();
+        assert(h != nullptr);
+        for(size_t i = 0; i < 2000; ++i)
+            ConcurrentAlloc(h, i * 7 % 3000 + 1);
+        ConcurrentAlloc(h, 1024 * 1024);
+        Heap::Destroy(h);
+    }
+    size_t vmAfter = GetVmSize();
+    assert(vmAfter < vmBefore + 64 * 1024 * 1024);
+
+    // 槽位用完时返回nullptr
+    std::vector<Heap*> heaps;
+    while(Heap* h = Heap::Create())
+        heaps.push_back(h);
+    assert(heaps.size() == Heap::MAX_HEAPS);
+    for(Heap* h : heaps)
+        Heap::Destroy(h);
+    cout << "独立堆测试通过 (反复创建销毁前后虚拟内存 " << vmBefore / 1048576 << "MB -> " << vmAfter / 1048576 << "MB)" << endl;
+    cout << endl;
+}
+
+void TestRegion()
+{
+    cout << "=== 测试区域分配器 ===" << endl;
+
+    Region region;
+    std::vector<std::pair<unsigned char*, size_t>> blocks;
+    for(size_t i = 0; i < 20000; ++i)
+    {
+        size_t size = i * 13 % 700;
+        size_t align = (size_t)1 << (i % 7);
+        unsigned char* p = (unsigned char*)region.Allocate(size, align);
+        assert(p != nullptr);
+        assert(((uintptr_t)p & (align - 1)) == 0);
+        memset(p, (int)(i & 0xFF), size);
+        blocks.emplace_back(p, size);
+    }
+    // 大申请单独一个span，超大的走 mmap
+    unsigned char* big = (unsigned char*)region.Allocate(300 * 1024);
+    memset(big, 0xAB, 300 * 1024);
+    unsigned char* huge = (unsigned char*)region.Allocate(4 * 1024 * 1024, 4096);
+    assert(((uintptr_t)huge & 4095) == 0);
+    memset(huge, 0xCD, 4 * 1024 * 1024);
+    // 大申请之后小申请仍接着用原来的块
+    unsigned char* after = (unsigned char*)region.Allocate(16);
+    memset(after, 0xEF, 16);
+
+    // 互不重叠：内容都还在
+    for(size_t i = 0; i < blocks.size(); ++i)
+    {
+        if(blocks[i].second > 0)
+        {
+            assert(blocks[i].first[0] == (unsigned char)(i & 0xFF));
+            assert(blocks[i].first[blocks[i].second - 1] == (unsigned char)(i & 0xFF));
+        }
+    }
+    assert(big[300 * 1024 - 1] == 0xAB && huge[0] == 0xCD && after[15] == 0xEF);
+    assert(region.BytesReserved() >= 4 * 1024 * 1024);
+
+    // Reset 后重新使用
+    region.Reset();
+    assert(region.BytesReserved() == 0);
+    for(size_t i = 0; i < 1000; ++i)
+        memset(region.Allocate(100), 0, 100);
+
+    // 建在 Heap 的页缓存上
+    Heap* heap = Heap::Create();
+    {
+        Region r(heap->GetPageCache());
+        for(size_t i = 0; i < 1000; ++i)
+            memset(r.Allocate(1000), 1, 1000);
+    }
+    Heap::Destroy(heap);
+    cout << "区域分配器测试通过" << endl;
+    cout << endl;
+}
+
+// 透明大页模式：环境变量在页缓存构造时读取，用一个新建的堆来测
+void TestHugePage()
+{
+    cout << "=== 测试透明大页模式 ===" << endl;
+
+    setenv("TCMALLOC_HUGEPAGE", "1", 1);
+    Heap* heap = Heap::Create();
+    unsetenv("TCMALLOC_HUGEPAGE");
+    PageCache* pc = heap->GetPageCache();
+    assert(pc->HugePageMode());
+
+    std::vector<void*> ptrs;
+    for(size_t i = 0; i < 20000; ++i)
+    {
+        size_t size = (i * 7919) % (MAX_BYTES / 8) + 1;
+        void* p = ConcurrentAlloc(heap, size);
+        memset(p, 0x5A, size);
+        ptrs.push_back(p);
+
+        // 按类别范围分组，小span不跨大页
+        Span* span = pc->MapObjToSpan(p);
+        assert(span->_lane == pc->LaneOf(span->_objSize));
+        assert((span->_pageId >> (HUGE_PAGE_SHIFT - PAGE_SHIFT)) ==
+            ((span->_pageId + span->_n - 1) >> (HUGE_PAGE_SHIFT - PAGE_SHIFT)));
+    }
+    // 超大span按大页对齐、整大页地要
+    void* big = ConcurrentAlloc(heap, 3 * 1024 * 1024);
+    memset(big, 0x6B, 3 * 1024 * 1024);
+    Span* bigSpan = pc->MapObjToSpan(big);
+    assert(((uintptr_t)big & (((uintptr_t)1 << HUGE_PAGE_SHIFT) - 1)) == 0);
+    assert(bigSpan->_n % HUGE_PAGE_PAGES == 0);
+    ptrs.push_back(big);
+
+    // 释放一半再申请，合并后的空闲span同样不跨大页
+    for(size_t i = 0; i < ptrs.size(); i += 2)
+        ConcurrentFree(heap, ptrs[i]);
+    for(size_t i = 0; i < ptrs.size(); i += 2)
+    {
+        size_t size = (i * 104729) % (MAX_BYTES / 4) + 1;
+        ptrs[i] = ConcurrentAlloc(heap, size);
+        memset(ptrs[i], 0x7C, size);
+        Span* span = pc->MapObjToSpan(ptrs[i]);
+        assert(span->_lane == pc->LaneOf(span->_objSize));
+        assert((span->_pageId >> (HUGE_PAGE_SHIFT - PAGE_SHIFT)) ==
+            ((span->_pageId + span->_n - 1) >> (HUGE_PAGE_SHIFT - PAGE_SHIFT)));
+    }
+    for(void* p : ptrs)
+        ConcurrentFree(heap, p);
+    Heap::Destroy(heap);
+    cout << "透明大页模式测试通过" << endl;
+    cout << endl;
+}
+
+// 预留地址再分段提交：页缓存的span从同一段预留区间里由低到高切出来
+void TestReserveCommit()
+{
+    cout << "=== 测试预留地址分段提交 ===" << endl;
+
+    // 每次都需要补货的页级span，地址依次递增(关闭预留时退回逐次 mmap，不检查)
+    const char* env = getenv("TCMALLOC_RESERVE_BYTES");
+    bool reserving = env == nullptr || strcmp(env, "0") != 0;
+    Heap* heap = Heap::Create();
+    std::vector<char*> ptrs;
+    for(size_t i = 0; i < 200; ++i)
+    {
+        char* p = (char*)ConcurrentAlloc(heap, 100 << PAGE_SHIFT);
+        memset(p, (int)i, 100 << PAGE_SHIFT);
+        if(reserving && !ptrs.empty())
+            assert(p > ptrs.back());
+        ptrs.push_back(p);
+    }
+    for(size_t i = 0; i < ptrs.size(); ++i)
+        assert(ptrs[i][0] == (char)i && ptrs[i][(100 << PAGE_SHIFT) - 1] == (char)i);
+    for(char* p : ptrs)
+        ConcurrentFree(heap, p);
+    Heap::Destroy(heap);
+
+    // 预留区间很小：用完后再预留下一段；销毁堆时连同没提交的部分一起还回去
+    ptrs.clear();
+    setenv("TCMALLOC_RESERVE_BYTES", "4194304", 1);
+    heap = Heap::Create();
+    unsetenv("TCMALLOC_RESERVE_BYTES");
+    for(size_t i = 0; i < 100000; ++i)
+    {
+        size_t size = i * 31 % 4000 + 1;
+        char* p = (char*)ConcurrentAlloc(heap, size);
+        memset(p, (int)(i & 0x7F), size);
+        ptrs.push_back(p);
+    }
+    for(size_t i = 0; i < ptrs.size(); i += 97)
+        assert(ptrs[i][0] == (char)(i & 0x7F));
+    // 补货的内存远超过一段预留区间，各段的地址都在销毁时解除映射
+    auto range = std::minmax_element(ptrs.begin(), ptrs.end());
+    assert((size_t)(*range.second - *range.first) > 4194304);
+    Heap::Destroy(heap);
+    for(size_t i = 0; i < ptrs.size(); i += 97)
+        assert(!IsMapped(ptrs[i]));
+
+    cout << "预留地址分段提交测试通过" << endl;
+    cout << endl;
+}
+
+// 进程实际占用的物理内存(字节)
+static size_t GetRss()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if(fp == nullptr)
+        return 0;
+    unsigned long vsz = 0, rss = 0;
+    if(fscanf(fp, "%lu %lu", &vsz, &rss) != 2)
+        rss = 0;
+    fclose(fp);
+    return (size_t)rss * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+void TestReleaseFreeMemory()
+{
+    cout << "=== 测试空闲页还给系统 ===" << endl;
+
+    // 先关掉按速度顺带还页，只测显式调用；MADV_FREE 时物理页不会马上少，内容也不保证为0
+    size_t rate = PageCache::GetReleaseRate();
+    PageCache::SetReleaseRate(0);
+    const char* env = getenv("TCMALLOC_MADV_FREE");
+    bool lazy = env != nullptr && strcmp(env, "1") == 0;
+
+    Heap* heap = Heap::Create();
+    PageCache* pc = heap->GetPageCache();
+    const size_t bytes = 100 << PAGE_SHIFT;
+    std::vector<char*> ptrs;
+    ptrs.reserve(160);
+    for(size_t i = 0; i < 160; ++i)
+    {
+        ptrs.push_back((char*)ConcurrentAlloc(heap, bytes));
+        memset(ptrs.back(), 0x5A, bytes);
+    }
+    for(char* p : ptrs)
+        ConcurrentFree(heap, p);
+    size_t rssFreed = GetRss();
+
+    size_t released;
+    {
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        released = pc->ReleaseFreePages((size_t)-1);
+        assert(pc->ReleasedPages() == released);
+        // 已经还过的不会再还
+        assert(pc->ReleaseFreePages((size_t)-1) == 0);
+    }
+    assert((released << PAGE_SHIFT) >= 160 * bytes);
+    size_t rssReleased = GetRss();
+    assert(lazy || rssFreed - rssReleased >= 160 * bytes / 2);
+
+    // 还过的span照常可用，MADV_DONTNEED 之后内容为0
+    for(size_t i = 0; i < ptrs.size(); ++i)
+    {
+        ptrs[i] = (char*)ConcurrentAlloc(heap, bytes);
+        assert(lazy || (ptrs[i][0] == 0 && ptrs[i][bytes - 1] == 0));
+        memset(ptrs[i], (int)i, bytes);
+    }
+    for(size_t i = 0; i < ptrs.size(); ++i)
+        assert(ptrs[i][0] == (char)i && ptrs[i][bytes - 1] == (char)i);
+    {
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        assert(pc->ReleasedPages() < released);
+    }
+
+    // 按速度顺带还：第一次释放记下时间，过了间隔之后的释放会还一批。
+    // 后台清理线程只替各分区的页缓存还，跑着时独立堆照常顺带还
+    PageCache::SetReleaseRate((size_t)1 << 40);
+    StartScavenger(60 * 1000);
+    ConcurrentFree(heap, ptrs[0]);
+    std::this_thread::sleep_for(std::chrono::milliseconds(PageCache::RELEASE_INTERVAL_MS + 50));
+    for(size_t i = 1; i < ptrs.size(); ++i)
+        ConcurrentFree(heap, ptrs[i]);
+    {
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        assert(pc->ReleasedPages() > 0);
+    }
+    StopScavenger();
+    PageCache::SetReleaseRate(0);
+    Heap::Destroy(heap);
+
+    // 全局页缓存：显式还页后照常申请(大页模式下这个大页里可能还有别的在用span)
+    char* p = (char*)ConcurrentAlloc(bytes);
+    memset(p, 0x33, bytes);
+    ConcurrentFree(p);
+    size_t trimmed = ConcurrentReleaseFreeMemory();
+    assert(PageCache::GetInstance()->HugePageMode() || trimmed >= bytes);
+    p = (char*)ConcurrentAlloc(bytes);
+    memset(p, 0x44, bytes);
+    assert(p[bytes - 1] == 0x44);
+    ConcurrentFree(p);
+
+    PageCache::SetReleaseRate(rate);
+    cout << "空闲页还给系统测试通过" << endl;
+    cout << endl;
+}
+
+void TestSpanBitmap()
+{
+    cout << "=== 测试页缓存非空位图 ===" << endl;
+
+    // 页缓存里只剩被在用的1页隔开的127页空闲span，小的申请都要从它们切，不能再向系统要
+    Heap* heap = Heap::Create();
+    PageCache* pc = heap->GetPageCache();
+    std::unique_lock<std::mutex> ul(pc->Getmtx());
+    std::vector<Span*> holes, pins;
+    for(size_t i = 0; i < 64; ++i)
+    {
+        holes.push_back(pc->NewSpan(NPAGES - 2));
+        holes.back()->_isUse = true;
+        pins.push_back(pc->NewSpan(1));
+        pins.back()->_isUse = true;
+    }
+    std::vector<PAGE_ID> holeIds;
+    for(Span* span : holes)
+    {
+        holeIds.push_back(span->_pageId);
+        pc->ReleaseSpanToPageCache(span);
+    }
+    std::sort(holeIds.begin(), holeIds.end());
+
+    for(size_t round = 0; round < 3; ++round)
+    {
+        std::vector<Span*> spans;
+        for(size_t k = 1; k <= 100; k += 11)
+        {
+            Span* span = pc->NewSpan(k);
+            span->_isUse = true;
+            auto it = std::upper_bound(holeIds.begin(), holeIds.end(), span->_pageId);
+            assert(it != holeIds.begin() && span->_pageId + k <= *(it - 1) + NPAGES - 2);
+            spans.push_back(span);
+        }
+        // 切剩的部分和还回来的合并回127页
+        for(Span* span : spans)
+            pc->ReleaseSpanToPageCache(span);
+    }
+    for(Span* span : pins)
+        pc->ReleaseSpanToPageCache(span);
+    // 全部合并之后再要整段的也能直接拿到
+    Span* span = pc->NewSpan(NPAGES - 1);
+    span->_isUse = true;
+    pc->ReleaseSpanToPageCache(span);
+    ul.unlock();
+
+    Heap::Destroy(heap);
+    cout << "页缓存非空位图测试通过" << endl;
+    cout << endl;
+}
+
+static size_t LargeCachedPages(PageCache* pc)
+{
+    std::lock_guard<std::mutex> lg(pc->Getmtx());
+    return pc->LargeCachedPages();
+}
+
+void TestLargeSpanCache()
+{
+    cout << "=== 测试超大span缓存 ===" << endl;
+
+    // 保留上限用默认值
+    const size_t MB = 1024 * 1024;
+    setenv("TCMALLOC_LARGE_CACHE_BYTES", "67108864", 1);
+    Heap* heap = Heap::Create();
+    unsetenv("TCMALLOC_LARGE_CACHE_BYTES");
+    PageCache* pc = heap->GetPageCache();
+
+    // 释放后留在缓存里，同样大小的再申请拿回同一块
+    char* p = (char*)ConcurrentAlloc(heap, 8 * MB);
+    memset(p, 0x11, 8 * MB);
+    ConcurrentFree(heap, p);
+    assert(LargeCachedPages(pc) == (8 * MB) >> PAGE_SHIFT);
+
+    // 最佳适配从低地址切，切剩的留在缓存里；都还回来后合并成原来的一整块
+    char* a = (char*)ConcurrentAlloc(heap, 2 * MB);
+    assert(a == p);
+    char* b = (char*)ConcurrentAlloc(heap, 4 * MB);
+    assert(b == p + 2 * MB);
+    assert(LargeCachedPages(pc) == (2 * MB) >> PAGE_SHIFT);
+    memset(a, 0x22, 2 * MB);
+    memset(b, 0x33, 4 * MB);
+    ConcurrentFree(heap, a);
+    ConcurrentFree(heap, b);
+    assert(LargeCachedPages(pc) == (8 * MB) >> PAGE_SHIFT);
+    char* c = (char*)ConcurrentAlloc(heap, 8 * MB);
+    assert(c == p);
+    assert(LargeCachedPages(pc) == 0);
+
+    // 对齐申请的首尾也留在缓存里
+    ConcurrentFree(heap, c);
+    {
+        std::lock_guard<std::mutex> lg(pc->Getmtx());
+        Span* span = pc->NewAlignedSpan((3 * MB) >> PAGE_SHIFT, MB >> PAGE_SHIFT);
+        assert(((span->_pageId << PAGE_SHIFT) & (MB - 1)) == 0);
+        assert(pc->LargeCachedPages() + span->_n == (8 * MB) >> PAGE_SHIFT);
+        pc->ReleaseSpanToPageCache(span);
+        assert(pc->LargeCachedPages() == (8 * MB) >> PAGE_SHIFT);
+        // 按速度还页不碰缓存，显式还时才 munmap
+        pc->ReleaseFreePages((size_t)-1);
+        assert(pc->LargeCachedPages() == (8 * MB) >> PAGE_SHIFT);
+        assert(pc->ReleaseLargeCache() == (8 * MB) >> PAGE_SHIFT);
+        assert(pc->LargeCachedPages() == 0);
+    }
+    Heap::Destroy(heap);
+
+    // 超过保留上限的还给系统
+    setenv("TCMALLOC_LARGE_CACHE_BYTES", "4194304", 1);
+    heap = Heap::Create();
+    unsetenv("TCMALLOC_LARGE_CACHE_BYTES");
+    pc = heap->GetPageCache();
+    p = (char*)ConcurrentAlloc(heap, 8 * MB);
+    ConcurrentFree(heap, p);
+    assert(LargeCachedPages(pc) == 0);
+    p = (char*)ConcurrentAlloc(heap, 2 * MB);
+    ConcurrentFree(heap, p);
+    assert(LargeCachedPages(pc) == (2 * MB) >> PAGE_SHIFT);
+    Heap::Destroy(heap);
+
+    // 释放span时按速度顺带还页，刚释放的超大span照样留在缓存里
+    size_t rate = PageCache::GetReleaseRate();
+    PageCache::SetReleaseRate(PageCache::DEFAULT_RELEASE_RATE);
+    heap = Heap::Create();
+    pc = heap->GetPageCache();
+    for (int i = 0; i < 3; ++i)
+    {
+        p = (char*)ConcurrentAlloc(heap, 4 * MB);
+        memset(p, i, 4 * MB);
+        ConcurrentFree(heap, p);
+        assert(LargeCachedPages(pc) == (4 * MB) >> PAGE_SHIFT);
+        std::this_thread::sleep_for(std::chrono::milliseconds(PageCache::RELEASE_INTERVAL_MS + 50));
+    }
+    Heap::Destroy(heap);
+
+    // 全局：缓存里取出的块照常 realloc，内容保留
+    p = (char*)ConcurrentAlloc(4 * MB);
+    char* q = (char*)ConcurrentAlloc(4 * MB);
+    ConcurrentFree(p);
+    ConcurrentFree(q);
+    p = (char*)ConcurrentAlloc(3 * MB);
+    for(size_t i = 0; i < 3 * MB; i += 4096)
+        p[i] = (char)(i >> 12);
+    p = (char*)ConcurrentRealloc(p, 7 * MB);
+    p = (char*)ConcurrentRealloc(p, 20 * MB);
+    for(size_t i = 0; i < 3 * MB; i += 4096)
+        assert(p[i] == (char)(i >> 12));
+    p = (char*)ConcurrentRealloc(p, 1 * MB);
+    assert(p[4096] == 1);
+    ConcurrentFree(p);
+
+    PageCache::SetReleaseRate(rate);
+    cout << "超大span缓存测试通过" << endl;
+    cout << endl;
+}
+
+void TestSpanShards()
+{
+    cout << "=== 测试页缓存分片 ===" << endl;
+
+    Heap* heap = Heap::Create();
+    PageCache* pc = heap->GetPageCache();
+
+    // 固定在一个CPU上，分片不变：还回去的span下一次原样取回
+    cpu_set_t old;
+    sched_getaffinity(0, sizeof(old), &old);
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(sched_getcpu(), &one);
+    sched_setaffinity(0, sizeof(one), &one);
+
+    const char* env = getenv("TCMALLOC_SPAN_SHARDS");
+    bool sharded = env == nullptr || strcmp(env, "0") != 0;
+    const size_t size = 16 * 1024;
+    Span* span = pc->NewSmallSpan(size);
+    assert(span->_isUse && !span->_isPageSpan && span->_objSize == size);
+    assert(span->_n == SizeClass::NumMovePage(size));
+    assert((span->_pageId & (SizeClass::SpanAlignPages(size) - 1)) == 0);
+    pc->ReleaseSmallSpan(span);
+    // 关闭分片时直接走页缓存，不保证拿回同一个
+    Span* again = pc->NewSmallSpan(size);
+    assert(!sharded || again == span);
+
+    // 分片满了整个还给页缓存，合并回去后能再拿到整段
+    std::vector<Span*> spans;
+    for(size_t i = 0; i < 2 * PageCache::SHARD_MAX_PAGES / span->_n; ++i)
+        spans.push_back(pc->NewSmallSpan(size));
+    spans.push_back(again);
+    for(Span* s : spans)
+        pc->ReleaseSmallSpan(s);
+    pc->FlushShards();
+
+    // 每个类别都补一次货，多出来的留在分片里也不超过上限
+    spans.clear();
+    for(size_t i = 0; i < NFREELIST; ++i)
+    {
+        spans.push_back(pc->NewSmallSpan(SizeClass::ClassSize(i)));
+        assert(pc->ShardPages() <= PageCache::SHARD_MAX_PAGES);
+    }
+    for(Span* s : spans)
+        pc->ReleaseSmallSpan(s);
+    pc->FlushShards();
+    sched_setaffinity(0, sizeof(old), &old);
+
+    // 多个线程、多个类别同时补货归还
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([heap, t]() {
+            std::vector<char*> v;
+            for(size_t round = 0; round < 4; ++round)
+            {
+                for(size_t i = 0; i < 5000; ++i)
+                {
+                    size_t bytes = (i * 131 + t * 977) % (64 * 1024) + 1;
+                    v.push_back((char*)ConcurrentAlloc(heap, bytes));
+                    v.back()[0] = (char)t;
+                    v.back()[bytes - 1] = (char)t;
+                }
+                for(char* p : v)
+                {
+                    assert(p[0] == (char)t);
+                    ConcurrentFree(heap, p);
+                }
+                v.clear();
+            }
+        });
+    }
+    for(auto& t : threads)
+        t.join();
+
+    // 分片里留着的span全部还回页缓存；没还的随堆一起还给系统
+    Heap* h2 = Heap::Create();
+    PageCache* pc2 = h2->GetPageCache();
+    for(size_t i = 0; i < 20000; ++i)
+        ConcurrentFree(h2, ConcurrentAlloc(h2, i % 4096 + 1));
+    pc2->FlushShards();
+    assert(pc2->ShardPages() == 0);
+    for(size_t i = 0; i < 20000; ++i)
+        ConcurrentFree(h2, ConcurrentAlloc(h2, i % 4096 + 1));
+    Heap::Destroy(h2);
+    Heap::Destroy(heap);
+
+    cout << "页缓存分片测试通过" << endl;
+    cout << endl;
+}
+
+// 在假拓扑下运行的子进程：0号CPU属于系统节点0，1-3号属于系统节点3(不存在，mbind 失败应被忽略)
+static int NumaChildMain()
+{
+    assert(NumaPartitions::Count() == 2);
+    assert(NumaPartitions::SystemNode(0) == 0 && NumaPartitions::SystemNode(1) == 3);
+    assert(NumaPartitions::CurrentNode() == 0);
+
+    size_t node;
+    std::vector<void*> local;
+    for(size_t i = 0; i < 10000; ++i)
+    {
+        local.push_back(ConcurrentAlloc(i % 2000 + 1));
+        memset(local.back(), 0x11, i % 2000 + 1);
+    }
+    void* big0 = ConcurrentAlloc(2 * 1024 * 1024);
+    memset(big0, 0x22, 2 * 1024 * 1024);
+    NumaPartitions::MapObjToSpan(big0, node);
+    assert(node == 0);
+
+#if defined(SYSTEM_HAVE_MEMPOLICY) && defined(SYS_get_mempolicy)
+    // 0号分区绑定在真实存在的节点0上
+    int mode = -1;
+    unsigned long mask[16] = {};
+    long rc = syscall(SYS_get_mempolicy, &mode, mask, sizeof(mask) * 8 + 1, big0, MPOL_F_ADDR);
+    assert(rc != 0 || (mode == MPOL_PREFERRED && (mask[0] & 1)));
+#endif
+
+    // 换到1号分区：新的申请来自1号分区，0号分区的对象在这里释放时直接还给0号分区
+    NumaPartitions::BindCurrentThread(1);
+    assert(NumaPartitions::CurrentNode() == 1);
+    std::vector<void*> remote;
+    for(size_t i = 0; i < 10000; ++i)
+    {
+        remote.push_back(ConcurrentAlloc(i % 2000 + 1));
+        memset(remote.back(), 0x33, i % 2000 + 1);
+        NumaPartitions::MapObjToSpan(remote.back(), node);
+        assert(node == 1);
+    }
+    void* big1 = ConcurrentAlloc(2 * 1024 * 1024);
+    NumaPartitions::MapObjToSpan(big1, node);
+    assert(node == 1);
+    big1 = ConcurrentRealloc(big1, 4 * 1024 * 1024);
+    NumaPartitions::MapObjToSpan(big1, node);
+    assert(node == 1 && ConcurrentUsableSize(big1) >= 4 * 1024 * 1024);
+
+    for(size_t i = 0; i < local.size(); ++i)
+    {
+        NumaPartitions::MapObjToSpan(local[i], node);
+        assert(node == 0);
+        ConcurrentFree(local[i], i % 2000 + 1);
+    }
+    ConcurrentFree(big0);
+    // 刚还回去的0号分区对象不会被1号分区的线程缓存拿到
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        void* p = ConcurrentAlloc(i % 2000 + 1);
+        NumaPartitions::MapObjToSpan(p, node);
+        assert(node == 1);
+        local[i] = p;
+    }
+    ConcurrentFreeBatch(local.data(), 1000);
+    ConcurrentFreeBatch(remote.data(), remote.size());
+    ConcurrentFree(big1);
+
+    // 新线程按所在CPU回到0号分区，在1号分区线程这里申请的对象交给它释放
+    std::vector<void*> handoff;
+    for(size_t i = 0; i < 1000; ++i)
+        handoff.push_back(ConcurrentAlloc(64));
+    std::thread t([&handoff]() {
+        assert(NumaPartitions::CurrentNode() == 0);
+        size_t n;
+        void* p = ConcurrentAlloc(64);
+        NumaPartitions::MapObjToSpan(p, n);
+        assert(n == 0);
+        ConcurrentFree(p);
+        for(void* q : handoff)
+            ConcurrentFree(q);
+    });
+    t.join();
+
+    Region region;
+    for(size_t i = 0; i < 1000; ++i)
+        memset(region.Allocate(1000), 1, 1000);
+    NumaPartitions::MapObjToSpan(region.Allocate(8 * 1024 * 1024), node);
+    assert(node == 1);
+    return 0;
+}
+
+// 用假的 sysfs 目录模拟两个节点，重新运行本程序：拓扑在第一次申请内存时就读好了，只能换个进程
+void TestNuma()
+{
+    cout << "=== 测试NUMA分区 ===" << endl;
+
+    // 真实机器上至少能退化成单分区
+    assert(NumaPartitions::Count() >= 1);
+    assert(NumaPartitions::CurrentNode() < NumaPartitions::Count());
+
+    char dir[] = "/tmp/numa_topoXXXXXX";
+    if(mkdtemp(dir) == nullptr)
+    {
+        cout << "无法创建临时目录，跳过" << endl << endl;
+        return;
+    }
+    const char* nodes[][2] = { {"node0", "0\n"}, {"node3", "1-3\n"} };
+    for(auto& n : nodes)
+    {
+        std::string path = std::string(dir) + "/" + n[0];
+        mkdir(path.c_str(), 0755);
+        FILE* fp = fopen((path + "/cpulist").c_str(), "w");
+        fputs(n[1], fp);
+        fclose(fp);
+    }
+
+    int status = -1;
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        setenv("TCMALLOC_NUMA_SYSFS", dir, 1);
+        execl("/proc/self/exe", "test_free", "--numa-child", (char*)nullptr);
+        _exit(127);
+    }
+    waitpid(pid, &status, 0);
+    for(auto& n : nodes)
+    {
+        std::string path = std::string(dir) + "/" + n[0];
+        unlink((path + "/cpulist").c_str());
+        rmdir(path.c_str());
+    }
+    rmdir(dir);
+
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        cout << "NUMA分区子进程失败, status " << status << endl;
+        abort();
+    }
+    cout << "两个分区下申请、跨分区释放、realloc、区域分配均正常" << endl;
+    cout << "NUMA分区测试通过" << endl;
+    cout << endl;
+}
+
+// 尺寸类别表：逐个检查 1..MAX_BYTES 的映射，以及每个类别的批量与span页数
+void TestSizeClassTable()
+{
+    cout << "=== 测试尺寸类别表 ===" << endl;
+
+    for(size_t s = 1; s <= MAX_BYTES; ++s)
+    {
+        size_t index = SizeClass::Index(s);
+        assert(index < NFREELIST);
+        assert(SizeClass::ClassSize(index) >= s);
+        assert(index == 0 || SizeClass::ClassSize(index - 1) < s);
+        assert(SizeClass::RoundUp(s) == SizeClass::ClassSize(index));
+    }
+    assert(SizeClass::ClassSize(NFREELIST - 1) == MAX_BYTES);
+
+    for(size_t i = 0; i < NFREELIST; ++i)
+    {
+        size_t size = SizeClass::ClassSize(i);
+        assert(SizeClass::Index(size) == i);
+        assert(size < MIN_ALIGN || size % MIN_ALIGN == 0);
+        size_t num = SizeClass::NumMoveSize(size);
+        assert(num >= 2 && num <= 512);
+        size_t pages = SizeClass::NumMovePage(size);
+        assert(pages >= MIN_SPAN_PAGES && pages <= NPAGES - 1);
+        // 一个span装得下一整批，切分后尾部浪费不超过1/8
+        size_t bytes = pages << PAGE_SHIFT;
+        assert(bytes / size >= num);
+        assert(bytes % size <= bytes / 8);
+    }
+    cout << NFREELIST << " 个类别检查通过" << endl;
+    cout << endl;
+}
+
+// 线程退出时线程缓存里的对象还给中心缓存，合计持有量回落
+void TestThreadCacheExit()
+{
+    cout << "=== 测试线程退出时归还线程缓存 ===" << endl;
+
+    // 96KB 这个类别别处不用，worker 释放后全部留在它的线程缓存里，span 仍算在用
+    const size_t bigSize = 96 * 1024;
+    void* big = nullptr;
+    std::atomic<int> stage(0);
+    std::thread worker([&stage, &big, bigSize]() {
+        while(stage.load() != 1)
+            std::this_thread::yield();
+        std::vector<void*> ptrs;
+        for(size_t i = 0; i < 1000; ++i)
+            ptrs.push_back(ConcurrentAlloc(i % 1024 + 1));
+        for(size_t i = 0; i < 4; ++i)
+            ptrs.push_back(ConcurrentAlloc(bigSize));
+        big = ptrs.back();
+        for(void* p : ptrs)
+            ConcurrentFree(p);
+        stage.store(2);
+        while(stage.load() != 3)
+            std::this_thread::yield();
+    });
+
+    // 两次读数之间主线程不申请释放，合计量的变化都来自 worker
+    size_t before = ThreadCache::TotalCachedBytes();
+    stage.store(1);
+    while(stage.load() != 2)
+        std::this_thread::yield();
+    size_t during = ThreadCache::TotalCachedBytes();
+    Span* span = PageCache::GetInstance()->FindSpan(big);
+    assert(span != nullptr && span->_isUse && span->_useCount > 0);
+    stage.store(3);
+    worker.join();
+    size_t after = ThreadCache::TotalCachedBytes();
+    cout << "退出前合计 " << during << " 字节，退出后 " << after << " 字节" << endl;
+    assert(during > before);
+    assert(after == before);
+    // 对象确实还给了中心缓存：span 里的对象全部收回(还在分片里或已还给页缓存)
+    span = PageCache::GetInstance()->FindSpan(big);
+    assert(span == nullptr || !span->_isUse || span->_useCount == 0);
+    cout << endl;
+}
+
+// 闲置回收：每条链表归还低水位的一半(向上取整)，并把低水位重置为当前长度
+void TestReleaseIdle()
+{
+    cout << "=== 测试线程缓存闲置回收 ===" << endl;
+
+    // 新建的堆上只有这一个类别的对象，CachedBytes 就是这条链表的长度乘对象大小
+    const size_t size = 64;
+    Heap* heap = Heap::Create();
+    ThreadCache* tc = heap->LocalCache();
+    std::vector<void*> ptrs;
+    for(size_t i = 0; i < 20; ++i)
+        ptrs.push_back(ConcurrentAlloc(heap, size));
+    for(void* p : ptrs)
+        ConcurrentFree(heap, p);
+    tc->ReleaseIdle();
+    size_t len = tc->CachedBytes() / size;
+    assert(len >= 6);
+
+    // 重置后低水位就是当前长度：再回收一次还掉一半
+    tc->ReleaseIdle();
+    size_t half = (len + 1) / 2;
+    assert(tc->CachedBytes() == (len - half) * size);
+    len -= half;
+
+    // 区间内借出2个又还回来：低水位是 len-2，只按它的一半还
+    void* a = ConcurrentAlloc(heap, size);
+    void* b = ConcurrentAlloc(heap, size);
+    ConcurrentFree(heap, a);
+    ConcurrentFree(heap, b);
+    tc->ReleaseIdle();
+    half = (len - 2 + 1) / 2;
+    assert(tc->CachedBytes() == (len - half) * size);
+    len -= half;
+
+    // 全部借出过(低水位为0)：什么都不还
+    ptrs.clear();
+    for(size_t i = 0; i < len; ++i)
+        ptrs.push_back(ConcurrentAlloc(heap, size));
+    for(void* p : ptrs)
+        ConcurrentFree(heap, p);
+    tc->ReleaseIdle();
+    assert(tc->CachedBytes() == len * size);
+
+    Heap::Destroy(heap);
+    cout << "闲置回收测试通过" << endl;
+    cout << endl;
+}
+
+// TCMALLOC_PERCPU=0 的子进程：每CPU缓存关闭，前端退回线程缓存
+static int PerCpuChildMain()
+{
+    assert(CpuCache::Current() == nullptr);
+    assert(CpuCache::Current() == nullptr);     // 第二次走已关闭的快速路径
+
+    void* p = ConcurrentAlloc(100);
+    memset(p, 0x33, 100);
+    ConcurrentFree(p, 100);
+    assert(CpuCache::TotalCachedBytes() == 0);
+    return 0;
+}
+
+// 每CPU缓存：多线程经由当前CPU的缓存申请/释放，释放时线程可能已迁到别的CPU
+void TestPerCpuCache()
+{
+    cout << "=== 测试每CPU缓存 ===" << endl;
+
+    if(CpuCache::Current() == nullptr)
+    {
+        cout << "rseq不可用，跳过每CPU部分" << endl;
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([t]() {
+                std::vector<std::pair<void*, size_t>> live;
+                for(size_t i = 0; i < 20000; ++i)
+                {
+                    size_t size = (i * 37 + t) % 1024 + 1;
+                    void* p = CpuCache::Current()->Allocate(size);
+                    memset(p, (int)(size & 0xff), size);
+                    live.emplace_back(p, size);
+                    if(live.size() > 64)
+                    {
+                        auto& o = live[i % live.size()];
+                        assert(((unsigned char*)o.first)[o.second - 1] == (o.second & 0xff));
+                        CpuCache::Current()->Deallocate(o.first, o.second);
+                        o = live.back();
+                        live.pop_back();
+                    }
+                }
+
+                void* batch[32];
+                CpuCache::Current()->AllocateBatch(48, 32, batch);
+                for(void* p : batch)
+                {
+                    memset(p, 48, 48);
+                    live.emplace_back(p, 48);
+                }
+                for(auto& o : live)
+                {
+                    assert(((unsigned char*)o.first)[0] == (o.second & 0xff));
+                    CpuCache::Current()->Deallocate(o.first, o.second);
+                }
+            });
+        }
+        for(auto& th : threads)
+            th.join();
+
+        // 没有线程再使用：反复闲置回收，每次还掉一半，最终全部归还
+        assert(CpuCache::TotalCachedBytes() > 0);
+        for(int i = 0; i < 64 && CpuCache::TotalCachedBytes() > 0; ++i)
+            CpuCache::ReleaseIdleAll();
+        assert(CpuCache::TotalCachedBytes() == 0);
+    }
+
+    int status = -1;
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        setenv("TCMALLOC_PERCPU", "0", 1);
+        execl("/proc/self/exe", "test_free", "--percpu-child", (char*)nullptr);
+        _exit(127);
+    }
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    cout << "每CPU缓存测试通过" << endl;
+    cout << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc > 1 && strcmp(argv[1], "--numa-child") == 0)
+        return NumaChildMain();
+    if(argc > 1 && strcmp(argv[1], "--percpu-child") == 0)
+        return PerCpuChildMain();
+
     cout << "========================================" << endl;
     cout << "    内存池归还功能测试程序" << endl;
     cout << "========================================" << endl;
@@ -383,6 +1706,69 @@ int main()
     
     // 8. 边界情况测试
     TestEdgeCases();
+
+    // 9. 带大小的释放测试
+    TestSizedFree();
+
+    // 10. 线程缓存字节预算测试
+    TestThreadCacheBudget();
+
+    // 11. 跨线程释放测试
+    TestCrossThreadFree();
+
+    // 12. 批量接口测试
+    TestBatchApi();
+
+    // 13. 对齐申请测试
+    TestAlignedAlloc();
+
+    // 14. realloc测试
+    TestRealloc();
+
+    // 15. calloc测试
+    TestCalloc();
+
+    // 16. 可用大小测试
+    TestUsableSize();
+
+    // 17. 独立堆测试
+    TestHeap();
+
+    // 18. 区域分配器测试
+    TestRegion();
+
+    // 19. NUMA分区测试
+    TestNuma();
+
+    // 20. 透明大页模式测试
+    TestHugePage();
+
+    // 21. 预留地址分段提交测试
+    TestReserveCommit();
+
+    // 22. 空闲页还给系统测试
+    TestReleaseFreeMemory();
+
+    // 23. 页缓存非空位图测试
+    TestSpanBitmap();
+
+    // 24. 超大span缓存测试
+    TestLargeSpanCache();
+
+    // 25. 页缓存分片测试
+    TestSpanShards();
+
+    // 26. 尺寸类别表测试
+    TestSizeClassTable();
+
+    // 27. 线程退出归还测试
+    TestThreadCacheExit();
+
+    // 28. 线程缓存闲置回收测试
+    TestReleaseIdle();
+
+    // 29. 每CPU缓存测试
+    TestPerCpuCache();
     
     cout << "========================================" << endl;
     cout << "    所有测试完成!" << endl;